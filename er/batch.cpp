@@ -0,0 +1,173 @@
+#include <er/batch.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <glob.h>
+#include <fmt/core.h>
+#include <er/parallel.hpp>
+#include <er/parser/parser.hpp>
+
+namespace fs = std::filesystem;
+
+namespace ER {
+
+std::optional<Graph> parse_file(const std::string &infile, Input &input, std::pmr::memory_resource *arena,
+                                std::string &diagnostics)
+{
+    LexContext ctx{ infile, input, arena };
+    yy::ERParser parser{ctx};
+    int res = parser.parse();
+    diagnostics += ctx.diagnostics;
+    if (res != 0)
+        return std::nullopt;
+    return ctx.take_graph();
+}
+
+bool stream_file(const std::string &infile, Input &input, std::pmr::memory_resource *arena,
+                 std::string &diagnostics, GraphStream &stream)
+{
+    LexContext ctx{ infile, input, arena, &stream };
+    yy::ERParser parser{ctx};
+    int res = parser.parse();
+    diagnostics += ctx.diagnostics;
+    return res == 0;
+}
+
+bool check_file(const std::string &infile, Input &input, std::pmr::memory_resource *arena,
+                std::string &diagnostics)
+{
+    LexContext ctx{ infile, input, arena };
+    ctx.check_only();
+    yy::ERParser parser{ctx};
+    int res = parser.parse();
+    diagnostics += ctx.diagnostics;
+    return res == 0;
+}
+
+bool names_many_files(std::string_view arg)
+{
+    std::error_code ec;
+    return arg.find_first_of("*?[") != arg.npos || fs::is_directory(arg, ec);
+}
+
+static void add_path(const std::string &path, std::vector<std::string> &files)
+{
+    std::error_code ec;
+    if (!fs::is_directory(path, ec)) {
+        files.push_back(path);
+        return;
+    }
+    std::vector<std::string> found;
+    for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+        if (it->is_regular_file(ec) && it->path().extension() == ".txt")
+            found.push_back(it->path().string());
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+std::vector<std::string> expand_inputs(std::span<char *const> args)
+{
+    std::vector<std::string> files;
+    for (const char *arg : args) {
+        glob_t matches;
+        if (std::strpbrk(arg, "*?[") && glob(arg, 0, nullptr, &matches) == 0) {
+            for (std::size_t i = 0; i < matches.gl_pathc; i++)
+                add_path(matches.gl_pathv[i], files);
+            globfree(&matches);
+        } else
+            add_path(arg, files);
+    }
+    return files;
+}
+
+namespace {
+
+struct Result {
+    bool ok = false;
+    double ms = 0;
+    std::string diagnostics;
+};
+
+}
+
+static Result process(const std::string &path, const OutputOptions &options, bool check)
+{
+    Result res;
+    auto input = Input::open(path);
+    if (!input)
+        return res;
+    if (check) {
+        std::pmr::monotonic_buffer_resource arena;
+        res.ok = check_file(path, *input, &arena, res.diagnostics);
+        return res;
+    }
+    // a stale output would look like the result of this run.
+    auto out_path = path + std::string(format_extension(options.format));
+    std::pmr::monotonic_buffer_resource arena;
+    std::optional<Graph> graph;
+    // streaming writes while parsing, so the output has to be open first.
+    if (!options.stream && !(graph = parse_file(path, *input, &arena, res.diagnostics))) {
+        std::remove(out_path.c_str());
+        return res;
+    }
+    std::FILE *out = std::fopen(out_path.c_str(), "w");
+    if (!out) {
+        res.diagnostics += fmt::format("error: couldn't write {}: {}\n", out_path, std::strerror(errno));
+        return res;
+    }
+    bool parsed = true;
+    if (graph)
+        write_graph(*graph, options, out);
+    else {
+        GraphStream stream(options.format, out);
+        parsed = stream_file(path, *input, &arena, res.diagnostics, stream);
+    }
+    res.ok = !std::ferror(out);
+    res.ok &= std::fclose(out) == 0;
+    if (!parsed) {
+        std::remove(out_path.c_str());
+        res.ok = false;
+    } else if (!res.ok)
+        res.diagnostics += fmt::format("error: couldn't write {}\n", out_path);
+    return res;
+}
+
+int run_batch(const std::vector<std::string> &files, unsigned jobs, const OutputOptions &options, bool check)
+{
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    std::vector<Result> results(files.size());
+    OutputOptions file_options = options;
+    file_options.jobs = 1;
+    stealing_for(files.size(), jobs, [&](std::size_t i) {
+        auto file_start = steady_clock::now();
+        results[i] = process(files[i], file_options, check);
+        results[i].ms = duration<double, std::milli>(steady_clock::now() - file_start).count();
+    });
+    double wall = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    std::size_t failed = 0;
+    double busy = 0;
+    for (std::size_t i = 0; i < files.size(); i++) {
+        const Result &res = results[i];
+        fmt::print("{} {:8.1f} ms  {}\n", res.ok ? "ok  " : "FAIL", res.ms, files[i]);
+        // errors already name their file, but are easier to tell apart indented.
+        std::string_view errors = res.diagnostics;
+        while (!errors.empty()) {
+            std::size_t nl = std::min(errors.find('\n'), errors.size());
+            fmt::print("    {}\n", errors.substr(0, nl));
+            errors.remove_prefix(std::min(nl + 1, errors.size()));
+        }
+        failed += !res.ok;
+        busy += res.ms;
+    }
+    fmt::print("{} files, {} ok, {} failed, in {:.1f} ms ({:.1f} ms of work on {} threads)\n",
+               files.size(), files.size() - failed, failed, wall, busy, jobs);
+    return failed != 0;
+}
+
+} // namespace ER
@@ -0,0 +1,52 @@
+#ifndef BATCH_HPP_INCLUDED
+#define BATCH_HPP_INCLUDED
+
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <er/graph.hpp>
+#include <er/input.hpp>
+#include <er/output.hpp>
+
+namespace ER {
+
+/* parses a whole diagram. errors are added to diagnostics. */
+std::optional<Graph> parse_file(const std::string &infile, Input &input, std::pmr::memory_resource *arena,
+                                std::string &diagnostics);
+
+/* parses a diagram, writing each top-level form to stream as soon as it's
+ * parsed. returns false on errors, which are added to diagnostics; whatever
+ * was written before the error stays written. */
+bool stream_file(const std::string &infile, Input &input, std::pmr::memory_resource *arena,
+                 std::string &diagnostics, GraphStream &stream);
+
+/* only looks for errors: names are resolved as in a full parse, but no graph
+ * is kept and nothing is written. returns false if there are any. */
+bool check_file(const std::string &infile, Input &input, std::pmr::memory_resource *arena,
+                std::string &diagnostics);
+
+/* whether a command line argument stands for more than one file: a directory
+ * or a pattern with wildcards. */
+bool names_many_files(std::string_view arg);
+
+/* the files named by the arguments of a batch run, in order. directories are
+ * searched recursively for .txt files, and patterns are expanded like the
+ * shell would, for when they come quoted. arguments naming nothing are kept,
+ * so that they're reported as failures. */
+std::vector<std::string> expand_inputs(std::span<char *const> args);
+
+/* parses every file on its own, on jobs threads, and writes its graph as
+ * options say to the file's path plus the format's extension. layouts run on
+ * the thread of their file. with check, files are only checked and nothing
+ * is written. once all files
+ * are done, prints how each of them went and how long it all took. returns 1
+ * if any file failed, 0 otherwise. */
+int run_batch(const std::vector<std::string> &files, unsigned jobs, const OutputOptions &options,
+              bool check = false);
+
+} // namespace ER
+
+#endif
@@ -1,9 +1,147 @@
 #include <er/graph.hpp>
 
-#include <fmt/core.h>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+#include <fmt/format.h>
+#include <er/util.hpp>
 
 namespace ER {
 
+static std::size_t hash_name(int parent, Symbol name, Node::Type type)
+{
+    std::uint64_t key = std::uint64_t(std::uint32_t(parent)) << 32 | name;
+    return ((key ^ std::uint64_t(type) << 24) * 0x9E3779B97F4A7C15u) >> 32;
+}
+
+// tables are kept at most two thirds full.
+static std::size_t index_size(std::size_t keys)
+{
+    std::size_t size = 16;
+    while (size < keys + keys / 2)
+        size *= 2;
+    return size;
+}
+
+std::string_view node_name(const Node &node, NameBuffer &buf)
+{
+    if (!node.anonymous)
+        return symbol_str(node.name);
+    char *p = buf.data(), *end = buf.data() + buf.size();
+    const auto put = [&](std::string_view str) { p = std::copy(str.begin(), str.end(), p); };
+    const auto card = [&](CardValue v) {
+        if (v.many)
+            *p++ = 'N';
+        else
+            p = std::to_chars(p, end, v.value).ptr;
+    };
+    p = std::to_chars(p, end, node.id).ptr;
+    switch (node.type) {
+    case Node::Type::PK:       put("_pk");       break;
+    case Node::Type::ASSOC:    put("_assoc");    break;
+    case Node::Type::FK:       put("_fk");       break;
+    case Node::Type::GERARCHY: put("_gerarchy"); break;
+    case Node::Type::CARD:
+        put("_card_");
+        card(node.info.card.first);
+        *p++ = '_';
+        card(node.info.card.second);
+        break;
+    default:
+        break;
+    }
+    return { buf.data(), std::size_t(p - buf.data()) };
+}
+
+int Graph::find(Symbol name, Node::Type type) const
+{
+    // a graph that was never built has no index.
+    if (name_slots.empty())
+        return -1;
+    std::size_t mask = name_slots.size() - 1;
+    for (std::size_t i = hash_name(-1, name, type) & mask; name_slots[i] != -1; i = (i + 1) & mask)
+        if (nodes[name_slots[i]].name == name && nodes[name_slots[i]].type == type)
+            return name_slots[i];
+    return -1;
+}
+
+int Graph::find_link(int parent, Symbol name, Node::Type type) const
+{
+    if (link_slots.empty())
+        return -1;
+    std::size_t mask = link_slots.size() - 1;
+    for (std::size_t i = hash_name(parent, name, type) & mask; link_slots[i].first != -1; i = (i + 1) & mask) {
+        auto [p, id] = link_slots[i];
+        if (p == parent && nodes[id].name == name && nodes[id].type == type)
+            return id;
+    }
+    return -1;
+}
+
+// width of the links of a node as printed, without the brackets.
+static int links_text_width(std::span<const int> links)
+{
+    if (links.empty())
+        return 4; // "None"
+    int w = 0;
+    for (int x : links)
+        w += 2 + util::count_digits(x);
+    return w;
+}
+
+// nodes are inserted in id order and links in link order, and a key that is
+// already there is never replaced, so the first match wins like in a linear scan.
+// anonymous nodes all share the empty name, so they're left out: they'd only
+// pile up on the same few slots.
+void Graph::build_index()
+{
+    name_slots.assign(index_size(nodes.size()), -1);
+    link_slots.assign(index_size(links_data.size()), {-1, -1});
+    std::size_t name_mask = name_slots.size() - 1, link_mask = link_slots.size() - 1;
+    name_width = links_width = 0;
+    NameBuffer namebuf;
+    for (const Node &node : nodes) {
+        name_width = std::max<int>(name_width, node_name(node, namebuf).size());
+        links_width = std::max(links_width, links_text_width(links(node.id)) + 2);
+        if (!node.anonymous) {
+            std::size_t i = hash_name(-1, node.name, node.type) & name_mask;
+            while (name_slots[i] != -1 && !(nodes[name_slots[i]].name == node.name && nodes[name_slots[i]].type == node.type))
+                i = (i + 1) & name_mask;
+            if (name_slots[i] == -1)
+                name_slots[i] = node.id;
+        }
+        for (int link : links(node.id)) {
+            const Node &l = nodes[link];
+            if (l.anonymous)
+                continue;
+            std::size_t j = hash_name(node.id, l.name, l.type) & link_mask;
+            while (link_slots[j].first != -1 && !(link_slots[j].first == node.id && nodes[link_slots[j].second].name == l.name
+                                                  && nodes[link_slots[j].second].type == l.type))
+                j = (j + 1) & link_mask;
+            if (link_slots[j].first == -1)
+                link_slots[j] = { node.id, link };
+        }
+    }
+}
+
+Graph GraphBuilder::freeze()
+{
+    Graph graph;
+    graph.offsets.resize(nodes.size() + 1);
+    for (std::size_t i = 0; i < nodes.size(); i++)
+        graph.offsets[i+1] = graph.offsets[i] + ranges[i].second;
+    graph.links_data.resize(graph.offsets.back());
+    for (std::size_t i = 0; i < nodes.size(); i++) {
+        auto l = links(i);
+        std::copy(l.begin(), l.end(), graph.links_data.begin() + graph.offsets[i]);
+    }
+    graph.nodes = std::move(nodes);
+    *this = GraphBuilder{};
+    graph.build_index();
+    return graph;
+}
+
 static int longest_name_width()
 {
 #define O(longname, shortname) #longname,
@@ -18,69 +156,202 @@ static int longest_name_width()
     return max->size();
 }
 
-int links_text_width(const auto &links)
+void graph_print(const Graph &graph, std::FILE *out)
 {
-    if (links.empty())
-        return 4; // "None"
-    int w = 0;
-    for (int x : links)
-        w += 2 + std::to_string(x).size();
-    return w;
-};
+    // rows are formatted straight into one buffer, padding included, and
+    // the buffer is written out whenever it gets big.
+    constexpr std::size_t flush_size = 64 * 1024;
+    int name_width = graph.name_column_width();
+    int type_width = longest_name_width();
+    int links_width = graph.links_column_width();
+    fmt::memory_buffer buf;
+    NameBuffer namebuf;
+    auto it = std::back_inserter(buf);
+    const auto append = [&](std::string_view str) { buf.append(str.data(), str.data() + str.size()); };
+    const auto pad = [&](std::size_t used, std::size_t width) {
+        if (used < width) {
+            std::size_t at = buf.size();
+            buf.resize(at + width - used);
+            std::memset(buf.data() + at, ' ', width - used);
+        }
+    };
 
-void graph_print(const Graph &graph)
-{
-    const auto format_links = [](const std::vector<int> &links)
-    {
+    fmt::format_to(it, "{:3} {:{}} {:{}} Anonymous? {:{}} Additional information\n",
+                   "ID", "Name", name_width, "Type", type_width, "Links", links_width);
+    for (const Node &node : graph) {
+        fmt::format_to(it, "{:3} ", node.id);
+        std::string_view name = node_name(node, namebuf);
+        append(name);
+        pad(name.size(), name_width);
+        buf.push_back(' ');
+        std::string type = node_type_str(node.type);
+        append(type);
+        pad(type.size(), type_width);
+        buf.push_back(' ');
+        append(node.anonymous ? "yes        " : "no         ");
+
+        auto links = graph.links(node.id);
+        std::size_t links_at = buf.size();
+        buf.push_back('[');
+        for (std::size_t i = 0; i < links.size(); i++) {
+            if (i != 0)
+                append(", ");
+            fmt::format_to(it, "{}", links[i]);
+        }
         if (links.empty())
-            return std::string("None");
-        std::string str;
-        str.reserve(links_text_width(links));
-        for (std::size_t i = 0; i < links.size() - 1; i++)
-            str += fmt::format("{}, ", links[i]);
-        return str + fmt::format("{}", links[links.size()-1]);
-    };
+            append("None");
+        buf.push_back(']');
+        pad(buf.size() - links_at, links_width);
+        buf.push_back(' ');
 
-    const auto format_info = [](const Node &node) -> std::string
-    {
         switch (node.type) {
         case Node::Type::CARD:
-            return fmt::format("Cardinality values: {}:{}",
-                       node.info.card.first.to_string(),
-                       node.info.card.second.to_string());
+            append("Cardinality values: ");
+            append(node.info.card.first.to_string());
+            buf.push_back(':');
+            append(node.info.card.second.to_string());
             break;
         case Node::Type::GERARCHY:
-            return fmt::format("Gerarchy type: {}", gerarchy_type_to_string(node.info.gertype));
+            append("Gerarchy type: ");
+            append(gerarchy_type_to_string(node.info.gertype));
+            break;
         default:
-            return "None";
+            append("None");
+        }
+        buf.push_back('\n');
+        if (buf.size() >= flush_size) {
+            std::fwrite(buf.data(), 1, buf.size(), out);
+            buf.clear();
         }
+    }
+    std::fwrite(buf.data(), 1, buf.size(), out);
+}
+
+static std::uint32_t compile_card(CardValue value)
+{
+    return value.many ? CompiledNode::CARD_MANY : value.value;
+}
+
+static CardValue load_card(std::uint32_t value)
+{
+    return value == CompiledNode::CARD_MANY ? CardValue(CARD_MANY) : CardValue(value);
+}
+
+bool is_compiled_graph(std::string_view text)
+{
+    return text.starts_with(std::string_view(CompiledHeader::MAGIC, sizeof(CompiledHeader::MAGIC)));
+}
+
+bool graph_write_compiled(const Graph &graph, std::FILE *out)
+{
+    std::vector<CompiledNode> nodes(graph.size());
+    std::string names;
+    std::unordered_map<Symbol, std::uint32_t> name_at;
+    for (const Node &node : graph) {
+        auto name = symbol_str(node.name);
+        auto [it, inserted] = name_at.try_emplace(node.name, names.size());
+        if (inserted)
+            names += name;
+        CompiledNode &c = nodes[node.id];
+        c = {};
+        c.name_at   = it->second;
+        c.name_size = name.size();
+        c.type      = std::uint8_t(node.type);
+        if (node.type == Node::Type::CARD) {
+            c.info |= CompiledNode::HAS_CARDINALITY;
+            c.cardinality[0] = compile_card(node.info.card.first);
+            c.cardinality[1] = compile_card(node.info.card.second);
+        } else if (node.type == Node::Type::GERARCHY)
+            c.info |= CompiledNode::HAS_GERARCHY | node.info.gertype;
+    }
+
+    auto offsets = graph.link_offsets();
+    auto links = graph.all_links();
+    const auto align = [](std::uint64_t n) { return (n + 7) & ~std::uint64_t(7); };
+    CompiledHeader header = {};
+    std::memcpy(header.magic, CompiledHeader::MAGIC, sizeof(header.magic));
+    header.byte_order = CompiledHeader::ORDER_MARK;
+    header.version    = CompiledHeader::VERSION;
+    header.num_nodes  = nodes.size();
+    header.num_links  = links.size();
+    header.names_size = names.size();
+    header.nodes_at   = align(sizeof(header));
+    header.offsets_at = align(header.nodes_at + nodes.size() * sizeof(CompiledNode));
+    header.links_at   = align(header.offsets_at + offsets.size_bytes());
+    header.names_at   = align(header.links_at + links.size_bytes());
+
+    std::uint64_t written = 0;
+    const auto write_at = [&](std::uint64_t at, const void *data, std::size_t size) {
+        static const char zeros[8] = {};
+        std::fwrite(zeros, 1, at - written, out);
+        std::fwrite(data, 1, size, out);
+        written = at + size;
     };
+    write_at(0, &header, sizeof(header));
+    write_at(header.nodes_at, nodes.data(), nodes.size() * sizeof(CompiledNode));
+    write_at(header.offsets_at, offsets.data(), offsets.size_bytes());
+    write_at(header.links_at, links.data(), links.size_bytes());
+    write_at(header.names_at, names.data(), names.size());
+    return !std::ferror(out);
+}
 
-    const auto max_link_width = [](const Graph &graph)
-    {
-        auto it = std::max_element(graph.begin(), graph.end(), [&](const auto &p, const auto &q) {
-            return links_text_width(p.second.links) < links_text_width(q.second.links);
-        });
-        return links_text_width(it->second.links) + 2;
+// the tables are copied out rather than used in place, so the text needs no
+// particular alignment. they're checked as they're copied, so that a damaged
+// file can't send anything out of bounds.
+std::optional<Graph> Graph::from_compiled(std::string_view text, const std::string &path, std::string &diagnostics)
+{
+    const auto fail = [&](std::string_view why) -> std::optional<Graph> {
+        fmt::format_to(std::back_inserter(diagnostics), "error: {}: {}\n", path, why);
+        return std::nullopt;
+    };
+    CompiledHeader header;
+    if (text.size() < sizeof(header) || !is_compiled_graph(text))
+        return fail("not a compiled graph");
+    std::memcpy(&header, text.data(), sizeof(header));
+    if (header.byte_order != CompiledHeader::ORDER_MARK)
+        return fail("compiled graph was written with a different byte order");
+    if (header.version != CompiledHeader::VERSION)
+        return fail(fmt::format("unsupported compiled graph version {}", header.version));
+    const auto fits = [&](std::uint64_t at, std::uint64_t count, std::size_t size) {
+        return at <= text.size() && count <= (text.size() - at) / size;
     };
+    if (!fits(header.nodes_at, header.num_nodes, sizeof(CompiledNode))
+     || !fits(header.offsets_at, std::uint64_t(header.num_nodes) + 1, sizeof(std::uint32_t))
+     || !fits(header.links_at, header.num_links, sizeof(int))
+     || !fits(header.names_at, header.names_size, 1))
+        return fail("compiled graph is truncated");
 
-    int name_width = std::max_element(graph.begin(), graph.end(), [](const auto &p, const auto &q) {
-        return p.second.name.size() < q.second.name.size();
-    })->second.name.size();
-    int type_width = longest_name_width();
-    int links_width = max_link_width(graph);
-
-    fmt::print("{:3} {:{}} {:{}} Anonymous? {:{}} Additional information\n",
-               "ID", "Name", name_width, "Type", type_width, "Links", links_width);
-    for (const auto &p : graph) {
-        fmt::print("{:3} {:{}} {:{}} {:10} {:{}} {}\n",
-                   p.second.id,
-                   p.second.name, name_width,
-                   node_type_str(p.second.type), type_width,
-                   p.second.anonymous ? "yes" : "no",
-                   "[" + format_links(p.second.links) + "]", links_width,
-                   format_info(p.second));
+    Graph graph;
+    graph.offsets.resize(header.num_nodes + std::size_t(1));
+    graph.links_data.resize(header.num_links);
+    std::memcpy(graph.offsets.data(), text.data() + header.offsets_at, graph.offsets.size() * sizeof(std::uint32_t));
+    std::memcpy(graph.links_data.data(), text.data() + header.links_at, graph.links_data.size() * sizeof(int));
+    if (graph.offsets.front() != 0 || graph.offsets.back() != header.num_links)
+        return fail("compiled graph is damaged");
+    // the hand-written parser may leave -1 for a key naming a missing
+    // attribute, which has no place in these graphs either.
+    for (int link : graph.links_data)
+        if (link < 0 || link >= int(header.num_nodes))
+            return fail("compiled graph is damaged");
+
+    auto names = text.substr(header.names_at, header.names_size);
+    graph.nodes.reserve(header.num_nodes);
+    for (std::uint32_t i = 0; i < header.num_nodes; i++) {
+        CompiledNode c;
+        std::memcpy(&c, text.data() + header.nodes_at + i * sizeof(c), sizeof(c));
+        if (graph.offsets[i] > graph.offsets[i+1] || c.type > std::uint8_t(Node::Type::CARD)
+         || c.name_at > names.size() || c.name_size > names.size() - c.name_at)
+            return fail("compiled graph is damaged");
+        auto name = names.substr(c.name_at, c.name_size);
+        Node &node = graph.nodes.emplace_back(Node::Type(c.type), symbol_intern(name), int(i));
+        node.anonymous = name.empty();
+        // the writer zeroes what a node doesn't use.
+        node.info.card = { load_card(c.cardinality[0]), load_card(c.cardinality[1]) };
+        if (c.info & CompiledNode::HAS_GERARCHY)
+            node.info.gertype = c.info & ~(CompiledNode::HAS_CARDINALITY | CompiledNode::HAS_GERARCHY);
     }
+    graph.build_index();
+    return graph;
 }
 
 std::string node_type_str(Node::Type type)
@@ -1,11 +1,17 @@
 #ifndef ERGRAPH_HPP_INCLUDED
 #define ERGRAPH_HPP_INCLUDED
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <span>
 #include <string>
-#include <map>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 #include <er/nodeprops.hpp>
+#include <er/symbol.hpp>
 
 namespace ER {
 
@@ -19,14 +25,15 @@ namespace ER {
     O(CARD, card) \
 
 struct Node {
-    enum class Type {
+    // a byte is plenty, and keeps the types kept while streaming small.
+    enum class Type : std::uint8_t {
         START,
 #define O(ename, sname) ename,
         NODE_TYPES(O)
 #undef O
     } type;
-    std::string name;
-    std::vector<int> links;
+    // anonymous nodes all have the empty name. see node_name.
+    Symbol name;
     int id;
     bool anonymous = false;
     // union for additional info, depending on the node type.
@@ -37,31 +44,184 @@ struct Node {
 
     Node() = default;
     // this is needed to silence a warning about the above union.
-    Node(Node::Type t, std::string &&n, std::vector<int> &&l, int i)
-        : type(t), name(n), links(l), id(i)
+    Node(Node::Type t, Symbol n, int i)
+        : type(t), name(n), id(i)
     { }
 };
 
-using Graph = std::map<int, Node>;
+/* the name of a node as it's written out. anonymous nodes don't intern one:
+ * theirs is made from the id and what they are, like "12_pk" or
+ * "12_card_0_N", and is written into buf, which the result points to. */
+using NameBuffer = std::array<char, 48>;
+std::string_view node_name(const Node &node, NameBuffer &buf);
 
-inline const Graph::const_iterator
-graph_find_node(const Graph &graph, const std::string &name, Node::Type type)
+/* a finished graph. ids go from 0 to size()-1, so nodes are stored in a
+ * vector indexed by id. links are in compressed sparse row form: the links
+ * of node i are links_data[offsets[i]] up to links_data[offsets[i+1]].
+ * graphs are built with a GraphBuilder and never change after that.
+ * names are indexed when the graph is built, both over the whole graph and
+ * over the links of each node. the indexes are open addressing tables that
+ * only keep ids: names and types are compared against the nodes themselves. */
+class Graph {
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> offsets = {0};
+    std::vector<int> links_data;
+    std::vector<int> name_slots;
+    std::vector<std::pair<int, int>> link_slots;
+    // widths of the name and links columns of graph_print, measured while
+    // indexing so that printing takes a single pass.
+    int name_width = 0;
+    int links_width = 0;
+
+    void build_index();
+
+    friend class GraphBuilder;
+
+public:
+    std::size_t size() const                    { return nodes.size(); }
+    bool empty() const                          { return nodes.empty(); }
+    const Node & operator[](int id) const       { return nodes[id]; }
+    Node::Type type(int id) const               { return nodes[id].type; }
+    std::span<const int> links(int id) const
+    {
+        return { links_data.data() + offsets[id], links_data.data() + offsets[id+1] };
+    }
+    std::vector<Node>::const_iterator begin() const { return nodes.begin(); }
+    std::vector<Node>::const_iterator end() const   { return nodes.end(); }
+    int name_column_width() const               { return name_width; }
+    int links_column_width() const              { return links_width; }
+    std::span<const std::uint32_t> link_offsets() const { return offsets; }
+    std::span<const int> all_links() const      { return links_data; }
+
+    // a graph written by graph_write_compiled. errors are added to
+    // diagnostics, and nothing is returned.
+    static std::optional<Graph> from_compiled(std::string_view text, const std::string &path,
+                                              std::string &diagnostics);
+
+    // the node with the lowest id called name, and the first link of parent
+    // called name. both return -1 if there is no such node. anonymous nodes
+    // are never found, as they can't be referenced.
+    int find(Symbol name, Node::Type type) const;
+    int find_link(int parent, Symbol name, Node::Type type) const;
+};
+
+/* nodes are added in any order (the parser adds children before their
+ * parents), and the links of a node may be added separately from the node.
+ * every id from 0 up to the biggest one must have been added before freezing.
+ * when streaming, the nodes added so far can be dropped once they're written
+ * out: only their types are kept, and later nodes go on from the same id.
+ * a builder that dropped nodes can't be frozen. */
+class GraphBuilder {
+    // nodes and ranges start at id base; types has the ids before it.
+    int base = 0;
+    std::vector<Node> nodes;
+    // for each id, the range of its links inside pending.
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+    std::vector<int> pending;
+    std::vector<Node::Type> types;
+
+    void grow(int id)
+    {
+        if (std::size_t(id - base) >= nodes.size()) {
+            nodes.resize(id - base + 1);
+            ranges.resize(id - base + 1);
+        }
+    }
+
+public:
+    void add(const Node &node)                  { grow(node.id); nodes[node.id - base] = node; }
+    void add_links(int id, std::span<const int> links)
+    {
+        grow(id);
+        ranges[id - base] = { std::uint32_t(pending.size()), std::uint32_t(links.size()) };
+        pending.insert(pending.end(), links.begin(), links.end());
+    }
+
+    // nodes and links can be looked at before freezing, as long as they were
+    // added and not dropped. dropped nodes have no links.
+    const Node & operator[](int id) const       { return nodes[id - base]; }
+    Node::Type type(int id) const               { return id < base ? types[id] : nodes[id - base].type; }
+    std::span<const int> links(int id) const
+    {
+        if (id < base || std::size_t(id - base) >= ranges.size())
+            return {};
+        return { pending.data() + ranges[id - base].first, ranges[id - base].second };
+    }
+
+    // the first id that wasn't dropped.
+    int dropped() const                         { return base; }
+    // every id up to the biggest one must have been added.
+    void drop()
+    {
+        for (const Node &n : nodes)
+            types.push_back(n.type);
+        base += nodes.size();
+        nodes.clear();
+        ranges.clear();
+        pending.clear();
+    }
+
+    // the builder is left empty.
+    Graph freeze();
+};
+
+// both return the id of the node found, or -1.
+inline int graph_find_node(const Graph &graph, Symbol name, Node::Type type)
 {
-    auto r = std::find_if(graph.begin(), graph.end(), [&](const auto &p) { return p.second.name == name && p.second.type == type; });
-    return r;
+    return graph.find(name, type);
 }
 
-inline const std::vector<int>::const_iterator
-graph_find_link(const Graph &graph, const Node &node, const std::string &name, Node::Type type)
+inline int graph_find_link(const Graph &graph, const Node &node, Symbol name, Node::Type type)
 {
-    auto r = std::find_if(node.links.begin(), node.links.end(), [&](int i) {
-        auto n = graph.find(i);
-        return n->second.name == name && n->second.type == type;
-    });
-    return r;
+    return graph.find_link(node.id, name, type);
 }
 
-void graph_print(const Graph &graph);
+/* the compiled form of a graph, for tools that need the graph of a diagram
+ * without parsing it again. it's the layout of the hand-written parser's
+ * CompiledHeader (see handrolled/graph.hpp), so either program reads what
+ * the other writes: a header, a table of nodes indexed by id, the link
+ * offsets and links as Graph keeps them, and a pool with the name of every
+ * node, each name stored once. anonymous nodes have an empty name. sections
+ * start on 8 byte boundaries, and numbers are in the byte order of the
+ * machine that wrote the file, which the header records. */
+struct CompiledHeader {
+    static constexpr char MAGIC[8] = "ERGRAPH";
+    static constexpr std::uint32_t ORDER_MARK = 0x01020304;
+    static constexpr std::uint32_t VERSION = 1;
+
+    char magic[8];
+    std::uint32_t byte_order;
+    std::uint32_t version;
+    std::uint32_t num_nodes;
+    std::uint32_t num_links;
+    std::uint64_t names_size;
+    std::uint64_t nodes_at;     // where each section starts, from the start of the file
+    std::uint64_t offsets_at;
+    std::uint64_t links_at;
+    std::uint64_t names_at;
+};
+
+struct CompiledNode {
+    static constexpr std::uint8_t HAS_CARDINALITY = 1 << 6;
+    static constexpr std::uint8_t HAS_GERARCHY    = 1 << 7;    // the GerType is in the low bits of info
+    static constexpr std::uint32_t CARD_MANY      = UINT32_MAX;
+
+    std::uint32_t name_at;      // in the name pool
+    std::uint32_t name_size;
+    std::uint8_t type;
+    std::uint8_t info;
+    std::uint16_t unused;
+    std::uint32_t cardinality[2];
+};
+
+static_assert(sizeof(CompiledHeader) == 64 && sizeof(CompiledNode) == 20);
+
+// whether the text of a file is a compiled graph rather than a diagram.
+bool is_compiled_graph(std::string_view text);
+// returns false if the file couldn't be written.
+bool graph_write_compiled(const Graph &graph, std::FILE *out = stdout);
+
+void graph_print(const Graph &graph, std::FILE *out = stdout);
 std::string node_type_str(Node::Type type);
 
 } // namespace ER
@@ -0,0 +1,126 @@
+#include <er/input.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fmt/core.h>
+
+namespace ER {
+
+Input & Input::operator=(Input &&other)
+{
+    if (this != &other) {
+        if (map)
+            munmap(const_cast<char *>(map), maplen);
+        map    = std::exchange(other.map, nullptr);
+        maplen = std::exchange(other.maplen, 0);
+        len    = std::exchange(other.len, 0);
+        buf    = std::move(other.buf);
+        if (owns_fd)
+            close(stream_fd);
+        stream_fd = std::exchange(other.stream_fd, -1);
+        owns_fd   = std::exchange(other.owns_fd, false);
+    }
+    return *this;
+}
+
+Input::~Input()
+{
+    if (map)
+        munmap(const_cast<char *>(map), maplen);
+    if (owns_fd)
+        close(stream_fd);
+}
+
+// the file is mapped over a zeroed anonymous mapping one byte larger than the
+// file. if the file ends in the middle of a page, the kernel zeroes the rest of
+// the page; if it ends on a page boundary, the next page is the anonymous one.
+// either way the sentinel is there without touching the file.
+bool Input::map_file(int fd, std::size_t size)
+{
+    std::size_t page  = sysconf(_SC_PAGESIZE);
+    std::size_t total = (size + 1 + page - 1) / page * page;
+    void *base = mmap(nullptr, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return false;
+    if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, total);
+        return false;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+    map    = static_cast<const char *>(base);
+    maplen = total;
+    len    = size;
+    return true;
+}
+
+// read straight into the buffer's storage, growing it geometrically.
+bool Input::read_file(int fd, std::size_t size_hint)
+{
+    const std::size_t chunk = 64 * 1024;
+    buf.resize(std::max(size_hint, chunk));
+    for (;;) {
+        if (len == buf.size())
+            buf.resize(buf.size() * 2);
+        ssize_t n = ::read(fd, buf.data() + len, buf.size() - len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (n == 0)
+            break;
+        len += n;
+    }
+    buf.resize(len);
+    return true;
+}
+
+long Input::read(char *dst, std::size_t n)
+{
+    for (;;) {
+        ssize_t r = ::read(stream_fd, dst, n);
+        if (r >= 0 || errno != EINTR)
+            return r;
+    }
+}
+
+std::optional<Input> Input::open(const std::string &pathname, bool stream)
+{
+    bool use_stdin = pathname == "-";
+    int fd = use_stdin ? STDIN_FILENO : ::open(pathname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fmt::print(stderr, "error: couldn't open file {}: {}\n", pathname, std::strerror(errno));
+        return std::nullopt;
+    }
+
+    Input input;
+    struct stat st;
+    bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (regular && st.st_size > 0 && input.map_file(fd, st.st_size)) {
+        if (!use_stdin)
+            close(fd);
+        return input;
+    }
+    if (stream) {
+        input.stream_fd = fd;
+        input.owns_fd   = !use_stdin;
+        return input;
+    }
+    bool ok = input.read_file(fd, regular ? st.st_size : 0);
+    int err = errno;
+    if (!use_stdin)
+        close(fd);
+    if (!ok) {
+        fmt::print(stderr, "error: couldn't read file {}: {}\n", pathname, std::strerror(err));
+        return std::nullopt;
+    }
+    return input;
+}
+
+} // namespace ER
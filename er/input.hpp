@@ -0,0 +1,53 @@
+#ifndef INPUT_HPP_INCLUDED
+#define INPUT_HPP_INCLUDED
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace ER {
+
+/* the text of a diagram, as given to the lexer.
+ * regular files are mapped read-only into memory, so they are never copied.
+ * anything that can't be mapped (pipes, terminals, stdin) is read into a
+ * buffer instead. in both cases the byte right after the text is a NUL,
+ * which the lexer uses as a sentinel.
+ * an input opened for streaming skips the buffer: unmappable files are left
+ * open and must be consumed piece by piece with read().
+ * the pathname "-" means stdin. */
+class Input {
+    const char *map = nullptr;
+    std::size_t maplen = 0;
+    std::size_t len = 0;
+    std::string buf;
+    int stream_fd = -1;
+    bool owns_fd = false;
+
+    bool map_file(int fd, std::size_t size);
+    bool read_file(int fd, std::size_t size_hint);
+
+public:
+    Input() = default;
+    Input(const Input &) = delete;
+    Input & operator=(const Input &) = delete;
+    Input(Input &&other) { *this = std::move(other); }
+    Input & operator=(Input &&other);
+    ~Input();
+
+    static std::optional<Input> open(const std::string &pathname, bool stream = false);
+
+    // reads at most n bytes of a streamed input. returns 0 at the end of the
+    // input and -1 on errors.
+    long read(char *dst, std::size_t n);
+
+    bool streaming() const      { return stream_fd >= 0; }
+    bool mapped() const         { return map != nullptr; }
+    const char *data() const    { return mapped() ? map : buf.c_str(); }
+    std::size_t size() const    { return len; }
+    std::string_view text() const { return { data(), len }; }
+};
+
+} // namespace ER
+
+#endif
@@ -0,0 +1,128 @@
+#include <er/output.hpp>
+
+#include <fmt/format.h>
+
+namespace ER {
+
+namespace {
+
+/* nodes are formatted straight into buf, which is written out whenever it
+ * gets big and then reused: apart from buf growing at the start, nothing is
+ * allocated however big the graph is. G is a Graph, or a GraphBuilder when
+ * streaming, as nodes only need their own links. */
+template <typename G>
+class JsonWriter {
+    static constexpr std::size_t flush_size = 64 * 1024;
+
+    const G &graph;
+    std::FILE *out;
+    fmt::memory_buffer buf;
+    NameBuffer namebuf;
+
+    void append(std::string_view str) { buf.append(str.data(), str.data() + str.size()); }
+
+    void string(std::string_view str)
+    {
+        static const char hex[] = "0123456789abcdef";
+        buf.push_back('"');
+        for (char c : str) {
+            if (c == '"' || c == '\\') {
+                buf.push_back('\\');
+                buf.push_back(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                append("\\u00");
+                buf.push_back(hex[c >> 4]);
+                buf.push_back(hex[c & 0xF]);
+            } else
+                buf.push_back(c);
+        }
+        buf.push_back('"');
+    }
+
+    // n for many is a string, so that numbers stay numbers.
+    void card_value(CardValue value)
+    {
+        if (value.many)
+            append("\"N\"");
+        else
+            fmt::format_to(std::back_inserter(buf), "{}", value.value);
+    }
+
+    static std::string_view type_name(Node::Type type)
+    {
+#define O(longname, shortname) #longname,
+        static const std::string_view names[] = {
+            "START",
+            NODE_TYPES(O)
+        };
+#undef O
+        return names[int(type)];
+    }
+
+    // cardinality and gerarchy are only there for the nodes that have them.
+    void node(const Node &node)
+    {
+        fmt::format_to(std::back_inserter(buf), "{{\"id\":{},\"type\":\"{}\",\"name\":", node.id, type_name(node.type));
+        string(node_name(node, namebuf));
+        append(node.anonymous ? ",\"anonymous\":true,\"links\":[" : ",\"anonymous\":false,\"links\":[");
+        auto links = graph.links(node.id);
+        for (std::size_t i = 0; i < links.size(); i++) {
+            if (i != 0)
+                buf.push_back(',');
+            fmt::format_to(std::back_inserter(buf), "{}", links[i]);
+        }
+        buf.push_back(']');
+        if (node.type == Node::Type::CARD) {
+            append(",\"cardinality\":{\"min\":");
+            card_value(node.info.card.first);
+            append(",\"max\":");
+            card_value(node.info.card.second);
+            buf.push_back('}');
+        } else if (node.type == Node::Type::GERARCHY) {
+            append(",\"gerarchy\":\"");
+            append(gerarchy_type_to_string(node.info.gertype));
+            buf.push_back('"');
+        }
+        buf.push_back('}');
+    }
+
+public:
+    JsonWriter(const G &g, std::FILE *f) : graph(g), out(f) { }
+
+    // a whole document has the nodes in an array, still one on each line;
+    // json lines has just the nodes, so that each line stands on its own.
+    // the nodes from first up to last are written after the start of the
+    // document if open, and before its end if close.
+    void write(int first, int last, bool lines, bool open, bool close)
+    {
+        if (open && !lines)
+            append("{\"nodes\":[\n");
+        for (int id = first; id < last; id++) {
+            node(graph[id]);
+            if (!lines && !(close && id + 1 == last))
+                buf.push_back(',');
+            buf.push_back('\n');
+            if (buf.size() >= flush_size) {
+                std::fwrite(buf.data(), 1, buf.size(), out);
+                buf.clear();
+            }
+        }
+        if (close && !lines)
+            append("]}\n");
+        std::fwrite(buf.data(), 1, buf.size(), out);
+    }
+};
+
+}
+
+void graph_write_json(const Graph &graph, bool lines, std::FILE *out)
+{
+    JsonWriter(graph, out).write(0, graph.size(), lines, true, true);
+}
+
+void graph_write_json(const GraphBuilder &graph, int first, int last, bool lines, bool open, bool close, std::FILE *out)
+{
+    JsonWriter(graph, out).write(first, last, lines, open, close);
+}
+
+} // namespace ER
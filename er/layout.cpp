@@ -0,0 +1,706 @@
+#include <er/layout.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <er/parallel.hpp>
+
+namespace ER {
+
+std::optional<LayoutMode> layout_mode_from_string(std::string_view name)
+{
+    if (name == "layered")
+        return LayoutMode::LAYERED;
+    if (name == "force")
+        return LayoutMode::FORCE;
+    return std::nullopt;
+}
+
+/* shapes are sized around the box of their label like graphviz does: an
+ * ellipse needs sqrt(2) times the size of the box to fit it, and a diamond
+ * twice the size. */
+std::vector<Size> node_sizes(const Graph &graph, TextMetrics &metrics)
+{
+    const double pad = metrics.size();
+    const double text_height = metrics.line_height();
+    std::vector<Size> sizes(graph.size());
+    for (const Node &node : graph) {
+        if (!is_drawn(node))
+            continue;
+        double text = node.anonymous ? 0 : metrics.width(node.name);
+        switch (node.type) {
+        case Node::Type::ENTITY:
+            sizes[node.id] = { std::max(text + 2 * pad, 4 * pad), text_height + pad };
+            break;
+        case Node::Type::ATTR:
+            sizes[node.id] = { std::max((text + pad) * std::numbers::sqrt2, 3 * pad),
+                               (text_height + pad / 5) * std::numbers::sqrt2 };
+            break;
+        case Node::Type::ASSOC:
+            sizes[node.id] = { std::max((text + pad) * 2, 4 * pad), (text_height + pad / 5) * 2 };
+            break;
+        default:
+            sizes[node.id] = { 8, 8 };
+        }
+    }
+    return sizes;
+}
+
+namespace {
+
+constexpr double node_sep = 20;
+constexpr double rank_sep = 50;
+constexpr double margin = 10;
+
+/* the part of the graph that gets drawn, with its nodes numbered from 0 in
+ * id order. edges go from the owner to what it owns: entities and
+ * associations to their attributes, associations to their entities through
+ * the cardinality nodes, and parents to children through the gerarchy. */
+struct Diagram {
+    std::vector<int> ids;
+    std::vector<Node::Type> types;
+    std::vector<Size> sizes;
+    std::vector<std::pair<int, int>> edges;
+
+    Diagram(const Graph &graph, std::span<const Size> node_sizes)
+    {
+        std::vector<int> index(graph.size(), -1);
+        for (const Node &node : graph) {
+            if (is_drawn(node)) {
+                index[node.id] = ids.size();
+                ids.push_back(node.id);
+                types.push_back(node.type);
+                sizes.push_back(node_sizes[node.id]);
+            }
+        }
+        for (int i = 0; i < int(ids.size()); i++) {
+            const Node &node = graph[ids[i]];
+            auto links = graph.links(node.id);
+            for (std::size_t k = 0; k < links.size(); k++) {
+                const Node &l = graph[links[k]];
+                if (node.type == Node::Type::GERARCHY) {
+                    // the parser puts the parent, if any, first.
+                    bool parent = k == 0 && has_parent(node.info.gertype);
+                    if (index[l.id] != -1)
+                        edges.push_back(parent ? std::pair{index[l.id], i} : std::pair{i, index[l.id]});
+                } else if (l.type == Node::Type::ATTR)
+                    edges.push_back({i, index[l.id]});
+                else if (node.type == Node::Type::ASSOC && l.type == Node::Type::CARD
+                         && !graph.links(l.id).empty() && index[graph.links(l.id)[0]] != -1)
+                    edges.push_back({i, index[graph.links(l.id)[0]]});
+            }
+        }
+    }
+
+    std::size_t size() const { return ids.size(); }
+};
+
+/* lists of ints by node, in compressed sparse row form like the links of a
+ * graph: item i of the input goes into the list of node key(i). */
+struct Adjacency {
+    std::vector<std::uint32_t> offsets;
+    std::vector<int> items;
+
+    template <typename Key, typename Value>
+    Adjacency(std::size_t nodes, std::size_t count, Key &&key, Value &&value)
+        : offsets(nodes + 2, 0), items(count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            offsets[key(i) + 2]++;
+        for (std::size_t i = 2; i < offsets.size(); i++)
+            offsets[i] += offsets[i-1];
+        for (std::size_t i = 0; i < count; i++)
+            items[offsets[key(i) + 1]++] = value(i);
+        offsets.pop_back();
+    }
+
+    std::span<const int> operator[](std::size_t i) const
+    {
+        return { items.data() + offsets[i], items.data() + offsets[i+1] };
+    }
+};
+
+/* sugiyama's method: the edges are made acyclic, nodes are put into layers
+ * so that every edge points downwards, edges spanning more than one layer
+ * are split by dummy nodes, the order inside each layer is chosen to reduce
+ * crossings, and finally x coordinates are picked close to the neighbors of
+ * each node without breaking that order. */
+class Layered {
+    const Diagram &diagram;
+    std::size_t n;
+    // of every node, dummies included.
+    std::vector<int> rank;
+    std::vector<double> width, height;
+    std::vector<std::pair<int, int>> segments;
+    std::vector<std::vector<int>> layers;
+    std::vector<double> x;
+
+    // turns around the edges that go back to a node still being visited.
+    std::vector<std::pair<int, int>> acyclic_edges()
+    {
+        std::vector<std::pair<int, int>> edges;
+        for (auto e : diagram.edges)
+            if (e.first != e.second)
+                edges.push_back(e);
+        Adjacency out(n, edges.size(), [&](std::size_t i) { return edges[i].first; },
+                                       [](std::size_t i) { return int(i); });
+        std::vector<char> state(n, 0);
+        std::vector<std::pair<int, std::uint32_t>> stack;
+        for (std::size_t root = 0; root < n; root++) {
+            if (state[root] != 0)
+                continue;
+            state[root] = 1;
+            stack.push_back({root, out.offsets[root]});
+            while (!stack.empty()) {
+                auto [v, at] = stack.back();
+                if (at == out.offsets[v+1]) {
+                    state[v] = 2;
+                    stack.pop_back();
+                    continue;
+                }
+                stack.back().second++;
+                int e = out.items[at];
+                int w = edges[e].second;
+                if (state[w] == 1)
+                    std::swap(edges[e].first, edges[e].second);
+                else if (state[w] == 0) {
+                    state[w] = 1;
+                    stack.push_back({w, out.offsets[w]});
+                }
+            }
+        }
+        return edges;
+    }
+
+    // longest path layering, then sources are moved down to sit right above
+    // the first thing they own, so that associations stay near their entities.
+    void assign_ranks(const std::vector<std::pair<int, int>> &edges)
+    {
+        Adjacency succ(n, edges.size(), [&](std::size_t i) { return edges[i].first; },
+                                        [&](std::size_t i) { return edges[i].second; });
+        std::vector<int> indegree(n, 0);
+        for (auto e : edges)
+            indegree[e.second]++;
+        std::vector<int> order;
+        order.reserve(n);
+        for (std::size_t v = 0; v < n; v++)
+            if (indegree[v] == 0)
+                order.push_back(v);
+        rank.assign(n, 0);
+        for (std::size_t i = 0; i < order.size(); i++) {
+            for (int w : succ[order[i]]) {
+                rank[w] = std::max(rank[w], rank[order[i]] + 1);
+                if (--indegree[w] == 0)
+                    order.push_back(w);
+            }
+        }
+        std::vector<char> has_pred(n, 0);
+        for (auto e : edges)
+            has_pred[e.second] = 1;
+        for (std::size_t v = 0; v < n; v++) {
+            if (has_pred[v] || succ[v].empty())
+                continue;
+            int lowest = std::numeric_limits<int>::max();
+            for (int w : succ[v])
+                lowest = std::min(lowest, rank[w]);
+            rank[v] = lowest - 1;
+        }
+    }
+
+    void split_long_edges(const std::vector<std::pair<int, int>> &edges)
+    {
+        width.resize(n);
+        height.resize(n);
+        for (std::size_t v = 0; v < n; v++) {
+            width[v] = diagram.sizes[v].width;
+            height[v] = diagram.sizes[v].height;
+        }
+        for (auto [from, to] : edges) {
+            for (int r = rank[from] + 1; r < rank[to]; r++) {
+                int dummy = rank.size();
+                rank.push_back(r);
+                width.push_back(0);
+                height.push_back(0);
+                segments.push_back({from, dummy});
+                from = dummy;
+            }
+            segments.push_back({from, to});
+        }
+    }
+
+    // nodes start in depth first order, which keeps what belongs together
+    // close even before crossings are looked at.
+    void initial_order(const Adjacency &down)
+    {
+        std::size_t total = rank.size();
+        std::vector<char> seen(total, 0);
+        std::vector<int> stack;
+        layers.assign(*std::max_element(rank.begin(), rank.end()) + 1, {});
+        for (std::size_t root = 0; root < total; root++) {
+            if (seen[root])
+                continue;
+            seen[root] = 1;
+            stack.push_back(root);
+            while (!stack.empty()) {
+                int v = stack.back();
+                stack.pop_back();
+                layers[rank[v]].push_back(v);
+                auto next = down[v];
+                for (auto it = next.rbegin(); it != next.rend(); ++it) {
+                    if (!seen[*it]) {
+                        seen[*it] = 1;
+                        stack.push_back(*it);
+                    }
+                }
+            }
+        }
+    }
+
+    // barycenter heuristic: each layer is sorted by the mean position of the
+    // neighbors of its nodes in the layer before it. positions are relative
+    // to the size of their layer, as layers can be very different in size.
+    void reduce_crossings(const Adjacency &up, const Adjacency &down)
+    {
+        std::vector<double> rel(rank.size());
+        const auto number = [&](const std::vector<int> &layer) {
+            for (std::size_t i = 0; i < layer.size(); i++)
+                rel[layer[i]] = (i + 0.5) / layer.size();
+        };
+        for (const auto &layer : layers)
+            number(layer);
+        std::vector<std::pair<double, int>> keyed;
+        const auto reorder = [&](std::vector<int> &layer, const Adjacency &adj) {
+            keyed.clear();
+            for (int v : layer) {
+                double sum = 0;
+                for (int w : adj[v])
+                    sum += rel[w];
+                keyed.push_back({ adj[v].empty() ? rel[v] : sum / adj[v].size(), v });
+            }
+            std::stable_sort(keyed.begin(), keyed.end(), [](const auto &p, const auto &q) { return p.first < q.first; });
+            for (std::size_t i = 0; i < layer.size(); i++)
+                layer[i] = keyed[i].second;
+            number(layer);
+        };
+        for (int pass = 0; pass < 4; pass++) {
+            for (std::size_t l = 1; l < layers.size(); l++)
+                reorder(layers[l], up);
+            for (std::size_t l = layers.size() - 1; l-- > 0; )
+                reorder(layers[l], down);
+        }
+    }
+
+    double separation(int v, int w) const
+    {
+        return (width[v] + width[w]) / 2 + node_sep;
+    }
+
+    /* moves the nodes of a layer as close as possible to where they want to
+     * be, in the least squares sense, keeping their order and the space
+     * between them. with y[i] = x[i] minus the least space needed by the
+     * nodes before i, this is isotonic regression, solved by pooling adjacent
+     * blocks that are out of order. */
+    void place(const std::vector<int> &layer, const std::vector<double> &wanted)
+    {
+        struct Block { double sum; int count; };
+        std::vector<Block> blocks;
+        std::vector<double> offset(layer.size(), 0);
+        for (std::size_t i = 0; i < layer.size(); i++) {
+            if (i > 0)
+                offset[i] = offset[i-1] + separation(layer[i-1], layer[i]);
+            blocks.push_back({ wanted[i] - offset[i], 1 });
+            while (blocks.size() > 1 && blocks[blocks.size()-2].sum * blocks.back().count
+                                        > blocks.back().sum * blocks[blocks.size()-2].count) {
+                blocks[blocks.size()-2].sum += blocks.back().sum;
+                blocks[blocks.size()-2].count += blocks.back().count;
+                blocks.pop_back();
+            }
+        }
+        std::size_t i = 0;
+        for (const Block &b : blocks)
+            for (int k = 0; k < b.count; k++, i++)
+                x[layer[i]] = b.sum / b.count + offset[i];
+    }
+
+    // the widest layer is packed first, and the others are placed outwards
+    // from it, each following the one before: sweeps that started from
+    // packed layers would take many passes to spread them out.
+    void assign_x(const Adjacency &up, const Adjacency &down)
+    {
+        x.assign(rank.size(), 0);
+        std::vector<double> widths;
+        for (const auto &layer : layers) {
+            double w = 0;
+            for (std::size_t i = 1; i < layer.size(); i++)
+                w += separation(layer[i-1], layer[i]);
+            widths.push_back(w);
+        }
+        std::size_t widest = std::max_element(widths.begin(), widths.end()) - widths.begin();
+        double at = 0;
+        for (std::size_t i = 0; i < layers[widest].size(); i++) {
+            at += i == 0 ? 0 : separation(layers[widest][i-1], layers[widest][i]);
+            x[layers[widest][i]] = at;
+        }
+        // nodes with no neighbors to follow want to stay next to the node
+        // before them, or after them for the ones at the start of the layer.
+        std::vector<double> wanted;
+        const auto align = [&](const std::vector<int> &layer, const Adjacency &adj) {
+            wanted.assign(layer.size(), std::numeric_limits<double>::quiet_NaN());
+            std::size_t first = layer.size();
+            for (std::size_t i = 0; i < layer.size(); i++) {
+                auto neighbors = adj[layer[i]];
+                if (neighbors.empty())
+                    continue;
+                double sum = 0;
+                for (int w : neighbors)
+                    sum += x[w];
+                wanted[i] = sum / neighbors.size();
+                first = std::min(first, i);
+            }
+            if (first == layer.size())
+                return;
+            for (std::size_t i = first; i-- > 0; )
+                wanted[i] = wanted[i+1] - separation(layer[i], layer[i+1]);
+            for (std::size_t i = first + 1; i < layer.size(); i++)
+                if (std::isnan(wanted[i]))
+                    wanted[i] = wanted[i-1] + separation(layer[i-1], layer[i]);
+            place(layer, wanted);
+        };
+        for (std::size_t l = widest; l-- > 0; )
+            align(layers[l], down);
+        for (std::size_t l = widest + 1; l < layers.size(); l++)
+            align(layers[l], up);
+        for (int pass = 0; pass < 4; pass++) {
+            for (std::size_t l = 1; l < layers.size(); l++)
+                align(layers[l], up);
+            for (std::size_t l = layers.size() - 1; l-- > 0; )
+                align(layers[l], down);
+        }
+    }
+
+public:
+    explicit Layered(const Diagram &d) : diagram(d), n(d.size()) { }
+
+    std::vector<Point> run()
+    {
+        std::vector<Point> pos(n);
+        if (n == 0)
+            return pos;
+        auto edges = acyclic_edges();
+        assign_ranks(edges);
+        split_long_edges(edges);
+        Adjacency up(rank.size(), segments.size(), [&](std::size_t i) { return segments[i].second; },
+                                                   [&](std::size_t i) { return segments[i].first; });
+        Adjacency down(rank.size(), segments.size(), [&](std::size_t i) { return segments[i].first; },
+                                                     [&](std::size_t i) { return segments[i].second; });
+        initial_order(down);
+        reduce_crossings(up, down);
+        assign_x(up, down);
+
+        double top = 0;
+        for (const auto &layer : layers) {
+            double tallest = 0;
+            for (int v : layer)
+                tallest = std::max(tallest, height[v]);
+            for (int v : layer)
+                if (std::size_t(v) < n)
+                    pos[v] = { x[v], top + tallest / 2 };
+            top += tallest + rank_sep;
+        }
+        return pos;
+    }
+};
+
+/* a spring-electrical model: every pair of nodes pushes apart, and edges
+ * pull their ends together. repulsion from far away nodes is approximated
+ * with a quadtree (barnes and hut), which brings every step down to
+ * O(n log n), and forces are evaluated on several threads. attributes owned
+ * by a single node only get in the way of the simulation, so they're left
+ * out of it and put in a ring around their owner at the end; the owner
+ * pushes as hard as all of them together. */
+class Force {
+    static constexpr double repulsion = 0.2;
+    static constexpr double gravity = 0.5;
+    static constexpr double theta = 1.0;
+    static constexpr int max_steps = 300;
+    static constexpr std::size_t chunk_size = 1024;
+
+    struct Cell {
+        double x = 0, y = 0, charge = 0;
+        double cx, cy, half;
+        int children = -1;
+        int body = -1;
+    };
+
+    const Diagram &diagram;
+    unsigned jobs;
+    // simulated nodes, and their index in the diagram.
+    std::vector<int> core;
+    std::vector<double> charge;
+    std::vector<Point> pos;
+    std::vector<std::vector<int>> leaves;
+    std::vector<double> ring;
+    double k;
+    std::vector<Cell> cells;
+
+    void build_tree()
+    {
+        double x0 = pos[0].x, x1 = x0, y0 = pos[0].y, y1 = y0;
+        for (const Point &p : pos) {
+            x0 = std::min(x0, p.x); x1 = std::max(x1, p.x);
+            y0 = std::min(y0, p.y); y1 = std::max(y1, p.y);
+        }
+        cells.clear();
+        Cell root;
+        root.cx = (x0 + x1) / 2;
+        root.cy = (y0 + y1) / 2;
+        root.half = std::max(x1 - x0, y1 - y0) / 2 + 1;
+        cells.push_back(root);
+        for (std::size_t b = 0; b < pos.size(); b++)
+            insert(0, b, 0);
+        for (Cell &c : cells) {
+            if (c.charge > 0) {
+                c.x /= c.charge;
+                c.y /= c.charge;
+            }
+        }
+    }
+
+    int quadrant(int c, int b) const
+    {
+        return cells[c].children + (pos[b].x >= cells[c].cx) + 2 * (pos[b].y >= cells[c].cy);
+    }
+
+    // charges and positions are summed on the way down, and divided once
+    // the tree is complete.
+    void insert(int c, int b, int depth)
+    {
+        for (;; depth++) {
+            cells[c].charge += charge[b];
+            cells[c].x += charge[b] * pos[b].x;
+            cells[c].y += charge[b] * pos[b].y;
+            if (cells[c].children != -1) {
+                c = quadrant(c, b);
+                continue;
+            }
+            if (cells[c].body == -1) {
+                cells[c].body = b;
+                return;
+            }
+            // nodes on top of each other would be split forever.
+            if (depth > 40)
+                return;
+            int old = cells[c].body;
+            cells[c].body = -1;
+            cells[c].children = cells.size();
+            double h = cells[c].half / 2;
+            for (int q = 0; q < 4; q++) {
+                Cell child;
+                child.cx = cells[c].cx + (q & 1 ? h : -h);
+                child.cy = cells[c].cy + (q & 2 ? h : -h);
+                child.half = h;
+                cells.push_back(child);
+            }
+            insert(quadrant(c, old), old, depth + 1);
+            c = quadrant(c, b);
+        }
+    }
+
+    Point force_on(int b, const Adjacency &adj) const
+    {
+        Point f;
+        const double scale = repulsion * k * k * charge[b];
+        int stack[4 * 64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Cell &c = cells[stack[--top]];
+            if (c.charge == 0 || (c.children == -1 && c.body == b && c.charge == charge[b]))
+                continue;
+            double dx = pos[b].x - c.x, dy = pos[b].y - c.y;
+            double d2 = dx * dx + dy * dy;
+            if (c.children == -1 || 4 * c.half * c.half < theta * theta * d2) {
+                if (d2 > 1e-9) {
+                    f.x += scale * c.charge * dx / d2;
+                    f.y += scale * c.charge * dy / d2;
+                }
+            } else {
+                for (int q = 0; q < 4; q++)
+                    stack[top++] = c.children + q;
+            }
+        }
+        // a weak pull towards the center keeps apart components together.
+        f.x += gravity * charge[b] * (cells[0].x - pos[b].x);
+        f.y += gravity * charge[b] * (cells[0].y - pos[b].y);
+        for (int w : adj[b]) {
+            double dx = pos[w].x - pos[b].x, dy = pos[w].y - pos[b].y;
+            double d = std::sqrt(dx * dx + dy * dy);
+            f.x += dx * d / k;
+            f.y += dy * d / k;
+        }
+        return f;
+    }
+
+    // nodes start on a spiral in breadth first order, so that neighbors
+    // start close to each other.
+    void initial_positions(const Adjacency &adj)
+    {
+        std::vector<char> seen(core.size(), 0);
+        std::vector<int> order;
+        order.reserve(core.size());
+        for (std::size_t root = 0; root < core.size(); root++) {
+            if (seen[root])
+                continue;
+            seen[root] = 1;
+            order.push_back(root);
+            for (std::size_t i = order.size() - 1; i < order.size(); i++)
+                for (int w : adj[order[i]])
+                    if (!seen[w]) {
+                        seen[w] = 1;
+                        order.push_back(w);
+                    }
+        }
+        pos.resize(core.size());
+        for (std::size_t i = 0; i < order.size(); i++) {
+            double r = k * std::sqrt(double(i)), a = i * 2.399963229728653;
+            pos[order[i]] = { r * std::cos(a), r * std::sin(a) };
+        }
+    }
+
+    // steps shrink while things settle and grow again while the energy keeps
+    // going down (hu's adaptive cooling).
+    void simulate(const Adjacency &adj)
+    {
+        std::vector<Point> forces(pos.size());
+        double step = k, energy = std::numeric_limits<double>::max();
+        int progress = 0;
+        for (int i = 0; i < max_steps && step > k * 0.005; i++) {
+            build_tree();
+            stealing_for((pos.size() + chunk_size - 1) / chunk_size, jobs, [&](std::size_t c) {
+                for (std::size_t b = c * chunk_size; b < std::min(pos.size(), (c + 1) * chunk_size); b++)
+                    forces[b] = force_on(b, adj);
+            });
+            double last = energy;
+            energy = 0;
+            for (std::size_t b = 0; b < pos.size(); b++) {
+                double len = std::sqrt(forces[b].x * forces[b].x + forces[b].y * forces[b].y);
+                energy += len * len;
+                if (len > 0) {
+                    pos[b].x += step * forces[b].x / len;
+                    pos[b].y += step * forces[b].y / len;
+                }
+            }
+            if (energy < last) {
+                if (++progress >= 5) {
+                    progress = 0;
+                    step /= 0.9;
+                }
+            } else {
+                progress = 0;
+                step *= 0.9;
+            }
+        }
+    }
+
+public:
+    Force(const Diagram &d, unsigned threads) : diagram(d), jobs(threads) { }
+
+    std::vector<Point> run()
+    {
+        std::size_t n = diagram.size();
+        std::vector<Point> result(n);
+        if (n == 0)
+            return result;
+        std::vector<int> degree(n, 0);
+        for (auto [from, to] : diagram.edges) {
+            degree[from]++;
+            degree[to]++;
+        }
+        // attributes that hang from one node and own nothing.
+        std::vector<int> owner(n, -1);
+        for (auto [from, to] : diagram.edges)
+            if (degree[to] == 1 && diagram.types[to] == Node::Type::ATTR)
+                owner[to] = from;
+        std::vector<int> index(n, -1);
+        for (std::size_t v = 0; v < n; v++) {
+            if (owner[v] == -1) {
+                index[v] = core.size();
+                core.push_back(v);
+            }
+        }
+        leaves.resize(core.size());
+        for (std::size_t v = 0; v < n; v++)
+            if (owner[v] != -1)
+                leaves[index[owner[v]]].push_back(v);
+
+        // rings are big enough to fit their attributes side by side.
+        ring.resize(core.size());
+        charge.resize(core.size());
+        double sum = 0;
+        for (std::size_t i = 0; i < core.size(); i++) {
+            const Size &own = diagram.sizes[core[i]];
+            double around = 0, widest = 0;
+            for (int leaf : leaves[i]) {
+                around += diagram.sizes[leaf].width + node_sep;
+                widest = std::max(widest, diagram.sizes[leaf].width);
+            }
+            ring[i] = leaves[i].empty() ? 0 : std::max(own.width / 2 + widest / 2 + node_sep, around / (2 * std::numbers::pi));
+            charge[i] = 1 + leaves[i].size();
+            sum += std::max(own.width, 2 * ring[i] + widest);
+        }
+        k = std::max(sum / core.size(), 60.0);
+
+        std::vector<std::pair<int, int>> links;
+        for (auto [from, to] : diagram.edges) {
+            if (index[from] != -1 && index[to] != -1 && from != to) {
+                links.push_back({index[from], index[to]});
+                links.push_back({index[to], index[from]});
+            }
+        }
+        Adjacency adj(core.size(), links.size(), [&](std::size_t i) { return links[i].first; },
+                                                 [&](std::size_t i) { return links[i].second; });
+        initial_positions(adj);
+        simulate(adj);
+
+        for (std::size_t i = 0; i < core.size(); i++) {
+            result[core[i]] = pos[i];
+            for (std::size_t j = 0; j < leaves[i].size(); j++) {
+                double a = 2 * std::numbers::pi * j / leaves[i].size();
+                result[leaves[i][j]] = { pos[i].x + ring[i] * std::cos(a), pos[i].y + ring[i] * std::sin(a) };
+            }
+        }
+        return result;
+    }
+};
+
+}
+
+Layout layout_graph(const Graph &graph, std::span<const Size> sizes, LayoutMode mode, unsigned jobs)
+{
+    Diagram diagram(graph, sizes);
+    auto pos = mode == LayoutMode::FORCE ? Force(diagram, jobs).run() : Layered(diagram).run();
+
+    // everything is moved so that the drawing starts at the margin.
+    Layout layout;
+    layout.pos.resize(graph.size());
+    layout.sizes.assign(sizes.begin(), sizes.end());
+    double x0 = std::numeric_limits<double>::max(), y0 = x0;
+    double x1 = std::numeric_limits<double>::lowest(), y1 = x1;
+    for (std::size_t i = 0; i < diagram.size(); i++) {
+        const Size &s = diagram.sizes[i];
+        x0 = std::min(x0, pos[i].x - s.width / 2);
+        x1 = std::max(x1, pos[i].x + s.width / 2);
+        y0 = std::min(y0, pos[i].y - s.height / 2);
+        y1 = std::max(y1, pos[i].y + s.height / 2);
+    }
+    if (diagram.size() == 0)
+        return layout;
+    for (std::size_t i = 0; i < diagram.size(); i++)
+        layout.pos[diagram.ids[i]] = { pos[i].x - x0 + margin, pos[i].y - y0 + margin };
+    layout.size = { x1 - x0 + 2 * margin, y1 - y0 + 2 * margin };
+    return layout;
+}
+
+} // namespace ER
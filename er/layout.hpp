@@ -0,0 +1,58 @@
+#ifndef LAYOUT_HPP_INCLUDED
+#define LAYOUT_HPP_INCLUDED
+
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <er/graph.hpp>
+#include <er/textmetrics.hpp>
+
+namespace ER {
+
+struct Point {
+    double x = 0, y = 0;
+};
+
+struct Size {
+    double width = 0, height = 0;
+};
+
+/* layered puts associations above their entities and attributes below
+ * their owner, sugiyama style. force lets the diagram spread out on its own,
+ * which suits big schemas with no clear top or bottom. */
+enum class LayoutMode {
+    LAYERED,
+    FORCE,
+};
+
+// for --layout=name. returns nothing for unknown names.
+std::optional<LayoutMode> layout_mode_from_string(std::string_view name);
+
+/* where the nodes of a diagram go. positions are the centers of the nodes,
+ * indexed by id, with y growing downwards; nodes that aren't drawn (the
+ * start node, keys, foreign keys and cardinalities) are left at 0,0.
+ * sizes are the ones the layout was made for. */
+struct Layout {
+    std::vector<Point> pos;
+    std::vector<Size> sizes;
+    Size size;
+};
+
+// whether a node is drawn as a shape of its own.
+inline bool is_drawn(const Node &node)
+{
+    return node.type == Node::Type::ENTITY || node.type == Node::Type::ASSOC
+        || node.type == Node::Type::ATTR   || node.type == Node::Type::GERARCHY;
+}
+
+// the size of the shape of each drawn node, big enough for its name.
+std::vector<Size> node_sizes(const Graph &graph, TextMetrics &metrics);
+
+/* places every drawn node of the graph, given the size of each, by id.
+ * the force mode evaluates forces on jobs threads. */
+Layout layout_graph(const Graph &graph, std::span<const Size> sizes, LayoutMode mode, unsigned jobs = 1);
+
+} // namespace ER
+
+#endif
@@ -0,0 +1,30 @@
+#include <er/location.hpp>
+
+#include <algorithm>
+
+namespace ER {
+
+void LineIndex::build(std::string_view text)
+{
+    if (built)
+        return;
+    // nothing past the last offset a Location can hold is ever asked for.
+    text = text.substr(0, std::min<std::size_t>(text.size(), Location::MAX_OFFSET));
+    starts.assign(1, 0);
+    starts.reserve(text.size() / 32 + 1);
+    for (std::size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\r' && i + 1 < text.size() && text[i+1] == '\n')
+            i++;
+        if (text[i] == '\n' || text[i] == '\r')
+            starts.push_back(i + 1);
+    }
+    built = true;
+}
+
+std::pair<unsigned, unsigned> LineIndex::position(std::uint32_t offset) const
+{
+    auto line = std::upper_bound(starts.begin(), starts.end(), offset) - 1;
+    return { line - starts.begin() + 1, offset - *line + 1 };
+}
+
+} // namespace ER
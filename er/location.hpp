@@ -0,0 +1,37 @@
+#ifndef LOCATION_HPP_INCLUDED
+#define LOCATION_HPP_INCLUDED
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ER {
+
+/* a location in the source, as a pair of byte offsets.
+ * lines and columns are only computed when needed, through a LineIndex.
+ * offsets are 32 bits, so inputs must be shorter than MAX_OFFSET bytes. */
+struct Location {
+    static constexpr std::uint32_t MAX_OFFSET = UINT32_MAX;
+    std::uint32_t begin = 0, end = 0;
+};
+
+/* the offsets at which each line of a source starts.
+ * the table is either built in one go from the whole text the first time a
+ * position is asked for, or filled in line by line with add_line() when the
+ * text isn't kept around (as when the lexer streams the input).
+ * a position is then found with a binary search. lines and columns start at 1;
+ * "\r\n", "\n" and a lone "\r" all end a line. */
+class LineIndex {
+    std::vector<std::uint32_t> starts = { 0 };
+    bool built = false;
+
+public:
+    void add_line(std::uint32_t offset) { starts.push_back(offset); }
+    void build(std::string_view text);
+    std::pair<unsigned, unsigned> position(std::uint32_t offset) const;
+};
+
+} // namespace ER
+
+#endif
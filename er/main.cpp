@@ -1,51 +1,135 @@
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <fmt/core.h>
+#include <er/batch.hpp>
 #include <er/graph.hpp>
-#include <er/parser/parser.hpp>
+#include <er/input.hpp>
+#include <er/output.hpp>
+#include <er/util.hpp>
 
 using namespace ER;
 
-inline std::string read_all(const char *pathname)
+int main(int argc, char *argv[])
 {
-    std::string str;
-    FILE *f = fopen(pathname, "r");
-    if (!f) {
-        fmt::print(stderr, "error: couldn't open file: ");
-        std::perror("");
-        return "";
+    // with several files, directories or patterns, every file is parsed on
+    // its own, on one thread per core unless told otherwise with -j, and its
+    // graph is written next to it. --check only reports errors, and exits
+    // with 1 if there are any. a compiled graph given as input is loaded
+    // instead of parsed, and written in any format.
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    OutputOptions options;
+    const char *outfile = nullptr;
+    bool checking = false;
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        std::string_view opt = argv[arg];
+        if (opt == "-j" && arg + 1 < argc) {
+            auto n = util::strconv<unsigned>(argv[arg+1]);
+            if (!n) {
+                fmt::print(stderr, "error: invalid number of jobs: {}\n", argv[arg+1]);
+                return 1;
+            }
+            jobs = n.value() != 0 ? n.value() : jobs;
+            arg++;
+        } else if (opt == "-o" && arg + 1 < argc)
+            outfile = argv[++arg];
+        else if (opt.starts_with("--format=")) {
+            auto f = format_from_string(opt.substr(opt.find('=') + 1));
+            if (!f) {
+                fmt::print(stderr, "error: unknown format: {}\n", opt.substr(opt.find('=') + 1));
+                return 1;
+            }
+            options.format = f.value();
+        } else if (opt == "--stream")
+            options.stream = true;
+        else if (opt == "--check")
+            checking = true;
+        else if (opt.starts_with("--layout=")) {
+            auto mode = layout_mode_from_string(opt.substr(opt.find('=') + 1));
+            if (!mode) {
+                fmt::print(stderr, "error: unknown layout: {}\n", opt.substr(opt.find('=') + 1));
+                return 1;
+            }
+            options.layout = mode.value();
+        } else
+            break;
+    }
+    if (arg >= argc) {
+        fmt::print(stderr, "usage: erlisp [-j jobs] [--format=table|dot|svg|json|jsonl|compiled] [--layout=layered|force] [--stream | --check] [-o output] [filename...]\n");
+        return 1;
+    }
+    if (options.stream && !GraphStream::supports(options)) {
+        fmt::print(stderr, "error: --stream needs --format=json, jsonl, or dot without a layout\n");
+        return 1;
+    }
+    if (argc - arg > 1 || names_many_files(argv[arg])) {
+        if (outfile) {
+            fmt::print(stderr, "error: -o needs a single input file\n");
+            return 1;
+        }
+        return run_batch(expand_inputs(std::span(argv + arg, argv + argc)), jobs, options, checking);
     }
 
-    fseek(f, 0L, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0L, SEEK_SET);
-    str.reserve(size);
-    for (int c; c = fgetc(f), c != EOF; )
-        str += c;
-    fclose(f);
-    return str;
-}
-
-Graph parse_file(const std::string &infile, const std::string &outfile, const std::string &contents)
-{
-    LexContext ctx{ infile, outfile, contents };
-    yy::ERParser parser{ctx};
-    parser.parse();
-    return ctx.getgraph();
-}
-
-int main(int argc, char *argv[])
-{
-    if (argc != 2) {
-        fmt::print(stderr, "usage: erlisp [filename]\n");
+    // inputs that can't be mapped are lexed through a fixed size window.
+    auto input = Input::open(argv[arg], true);
+    if (!input)
         return 1;
+    std::string filename = argv[arg];
+    // scratch memory for the parser, released all at once.
+    std::pmr::monotonic_buffer_resource arena;
+    std::string diagnostics;
+    std::optional<Graph> graph;
+    // only files that can be mapped are looked at: pipes are lexed as they're read.
+    if (input->mapped() && is_compiled_graph(input->text())) {
+        graph = Graph::from_compiled(input->text(), filename, diagnostics);
+        fmt::print(stderr, "{}", diagnostics);
+        if (!graph || checking)
+            return graph ? 0 : 1;
+    } else if (checking) {
+        bool ok = check_file(filename, *input, &arena, diagnostics);
+        fmt::print(stderr, "{}", diagnostics);
+        return ok ? 0 : 1;
+    }
+    // streaming writes while parsing, so the output has to be open first.
+    if (!graph && !options.stream) {
+        graph = parse_file(filename, *input, &arena, diagnostics);
+        fmt::print(stderr, "{}", diagnostics);
+        if (!graph)
+            return 1;
     }
-    std::string contents = read_all(argv[1]);
-    if (contents.empty())
+    // without -o, or with -o -, the output goes to stdout.
+    std::FILE *out = stdout;
+    if (outfile && std::string_view(outfile) != "-") {
+        out = std::fopen(outfile, "wb");
+        if (!out) {
+            fmt::print(stderr, "error: couldn't write {}: {}\n", outfile, std::strerror(errno));
+            return 1;
+        }
+    }
+    if (graph) {
+        options.jobs = jobs;
+        write_graph(*graph, options, out);
+    } else {
+        GraphStream stream(options.format, out);
+        bool parsed = stream_file(filename, *input, &arena, diagnostics, stream);
+        fmt::print(stderr, "{}", diagnostics);
+        if (!parsed) {
+            if (out != stdout)
+                std::fclose(out);
+            return 1;
+        }
+    }
+    bool ok = !std::ferror(out);
+    ok &= out == stdout || std::fclose(out) == 0;
+    if (!ok) {
+        fmt::print(stderr, "error: couldn't write {}\n", outfile ? outfile : "output");
         return 1;
-    std::string filename = argv[1];
-    std::string output = "output.txt";
-    Graph graph = parse_file(filename, output, contents);
-    graph_print(graph);
+    }
 }
-
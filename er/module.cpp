@@ -0,0 +1,70 @@
+#include <er/module.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+#include <er/input.hpp>
+#include <er/parser/parser.hpp>
+
+namespace ER {
+
+// a module that failed gives every include of it the reason why.
+const Module *ModuleCache::found(const Entry &entry, std::string &diagnostics)
+{
+    if (!entry.module)
+        diagnostics += entry.diagnostics;
+    return entry.module.get();
+}
+
+const Module *ModuleCache::load(const std::string &path, std::string &diagnostics)
+{
+    auto input = Input::open(path);
+    if (!input)
+        return nullptr;
+    auto text = input->text();
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(path, ec);
+    auto key = std::make_pair(ec ? path : canonical.string(), std::uint64_t(std::hash<std::string_view>()(text)));
+    auto same_text = [&](const Entry &e) { return e.text == text; };
+    {
+        std::lock_guard<std::mutex> guard{lock};
+        if (auto it = modules.find(key); it != modules.end())
+            if (auto e = std::find_if(it->second.begin(), it->second.end(), same_text); e != it->second.end())
+                return found(*e, diagnostics);
+    }
+    // the files this thread is in the middle of parsing.
+    static thread_local std::vector<std::string> loading;
+    if (std::find(loading.begin(), loading.end(), key.first) != loading.end()) {
+        fmt::format_to(std::back_inserter(diagnostics), "error: {} includes itself\n", path);
+        return nullptr;
+    }
+    loading.push_back(key.first);
+    std::pmr::monotonic_buffer_resource arena;
+    LexContext ctx{ path, *input, &arena };
+    ctx.defer_unknown_names();
+    yy::ERParser parser{ctx};
+    bool ok = parser.parse() == 0;
+    loading.pop_back();
+
+    std::lock_guard<std::mutex> guard{lock};
+    auto &entries = modules[key];
+    if (auto e = std::find_if(entries.begin(), entries.end(), same_text); e != entries.end())
+        return found(*e, diagnostics);
+    diagnostics += ctx.diagnostics;
+    auto &e = entries.emplace_back(Entry{ std::string(text), nullptr, ok ? "" : ctx.diagnostics });
+    if (ok)
+        e.module = std::make_unique<Module>(ctx.take_module());
+    return e.module.get();
+}
+
+ModuleCache &module_cache()
+{
+    static ModuleCache cache;
+    return cache;
+}
+
+} // namespace ER
@@ -0,0 +1,72 @@
+#ifndef MODULE_HPP_INCLUDED
+#define MODULE_HPP_INCLUDED
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <er/graph.hpp>
+#include <er/symbol.hpp>
+
+namespace ER {
+
+/* a file brought into diagrams with (include "path"), parsed on its own.
+ * node 0 is the start node of the file, which links to its top-level objects.
+ * names the file doesn't define are left unresolved: a link of
+ * unresolved_link(i) stands for the node named by unresolved[i], and is
+ * resolved every time the module is spliced into a diagram, against what was
+ * defined before them. the modules it includes are spliced where they were
+ * included, before the node whose id was next at that point. */
+struct Module {
+    struct Reference {
+        Node::Type type;
+        Symbol name;
+        std::optional<Symbol> attr;     // for (attr x entity) references: x, with entity in name
+    };
+
+    std::string path;
+    GraphBuilder graph;
+    int size = 0;
+    std::vector<Reference> unresolved;
+    std::vector<std::pair<int, const Module *>> includes;   // by the id of the node after them
+};
+
+constexpr int unresolved_link(std::size_t i)        { return -1 - int(i); }
+constexpr bool is_unresolved(int link)              { return link < 0; }
+constexpr std::size_t unresolved_index(int link)    { return -1 - link; }
+
+/* every module parsed by the process, by canonical path and the hash of its
+ * contents, so that a file shared by many diagrams is only parsed once, and
+ * parsed again if it changes. the path is part of the key because the
+ * includes of a module are relative to it: the same text in two directories
+ * can stand for different diagrams. a hash hit only counts if the text is
+ * the same too. threads parsing different diagrams can share it: the table
+ * is only locked to look modules up and to store them. two threads asking
+ * for the same new module both parse it and the first one to finish wins,
+ * so that no thread waits on a file that may be including its own. */
+class ModuleCache {
+    struct Entry {
+        std::string text;
+        std::unique_ptr<Module> module;     // null if the file had errors,
+        std::string diagnostics;            // which are kept for later includes
+    };
+
+    std::mutex lock;
+    std::map<std::pair<std::string, std::uint64_t>, std::vector<Entry>> modules;
+
+    const Module *found(const Entry &entry, std::string &diagnostics);
+
+public:
+    // errors are added to diagnostics, and null is returned.
+    const Module *load(const std::string &path, std::string &diagnostics);
+};
+
+ModuleCache &module_cache();
+
+} // namespace ER
+
+#endif
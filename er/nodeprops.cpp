@@ -25,13 +25,12 @@ Cardinality make_card_value(const std::string &str)
     return { *cv1, *cv2 };
 }
 
-using namespace std::literals;
-
-std::string gerarchy_type_to_string(GerType type)
+std::string_view gerarchy_type_to_string(GerType type)
 {
-    return is_subset(type) ? "subset" :
-           (is_total(type) ? "total"s : "partial"s) + " "s +
-           (is_exclusive(type) ? "exclusive"s : "overlapped"s);
+    static const std::string_view names[] = {
+        "partial overlapped", "partial exclusive", "total overlapped", "total exclusive",
+    };
+    return is_subset(type) ? "subset" : names[is_total(type) * 2 + is_exclusive(type)];
 }
 
 } // namespace ER
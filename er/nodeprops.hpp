@@ -49,12 +49,14 @@ using GerType = uint8_t;
 //        ^ total/partial bit (total: 1, partial: 0)
 //       ^ exclusive/overlapped bit (exclusive: 1, overlapped: 0)
 //      ^ subset bit
+//     ^ parent bit: the first link is the parent, the others are children
 enum GerFlag {
     GERFLAG_EXCLUSIVE   = 1 << 0,
     GERFLAG_OVERLAPPED  = 0,
     GERFLAG_TOTAL       = 1 << 1,
     GERFLAG_PARTIAL     = 0,
     GERFLAG_SUBSET      = 1 << 2,
+    GERFLAG_PARENT      = 1 << 3,
 };
 
 inline bool is_subset(GerType type)        { return type & GERFLAG_SUBSET; }
@@ -62,11 +64,13 @@ inline bool is_total(GerType type)         { return !is_subset(type) && type & G
 inline bool is_partial(GerType type)       { return !is_subset(type) && !is_total(type); }
 inline bool is_exclusive(GerType type)     { return !is_subset(type) && type & GERFLAG_EXCLUSIVE; }
 inline bool is_overlapped(GerType type)    { return !is_subset(type) && !is_exclusive(type); }
+inline bool has_parent(GerType type)       { return type & GERFLAG_PARENT; }
 
 inline GerType make_gerarchy_subset() { return GERFLAG_SUBSET; }
 inline GerType make_gerarchy_type(bool total, bool exclusive) { return (total ? GERFLAG_TOTAL : 0) | (exclusive ? GERFLAG_EXCLUSIVE : 0); }
 
-std::string gerarchy_type_to_string(GerType type);
+// the names are static, so writers can use them without copying.
+std::string_view gerarchy_type_to_string(GerType type);
 
 } // namespace ER
 
@@ -0,0 +1,287 @@
+#include <er/output.hpp>
+
+#include <fmt/format.h>
+
+namespace ER {
+
+std::optional<Format> format_from_string(std::string_view name)
+{
+    if (name == "table")
+        return Format::TABLE;
+    if (name == "dot")
+        return Format::DOT;
+    if (name == "svg")
+        return Format::SVG;
+    if (name == "json")
+        return Format::JSON;
+    if (name == "jsonl")
+        return Format::JSONL;
+    if (name == "compiled")
+        return Format::COMPILED;
+    return std::nullopt;
+}
+
+std::string_view format_extension(Format format)
+{
+    switch (format) {
+    case Format::DOT:
+        return ".dot";
+    case Format::SVG:
+        return ".svg";
+    case Format::JSON:
+        return ".json";
+    case Format::JSONL:
+        return ".jsonl";
+    case Format::COMPILED:
+        return ".erg";
+    default:
+        return ".out";
+    }
+}
+
+void write_graph(const Graph &graph, const OutputOptions &options, std::FILE *out)
+{
+    std::optional<Layout> layout;
+    auto mode = options.format == Format::SVG ? options.layout.value_or(LayoutMode::LAYERED) : options.layout;
+    if (mode && (options.format == Format::DOT || options.format == Format::SVG)) {
+        TextMetrics metrics(LABEL_FONT_SIZE);
+        layout = layout_graph(graph, node_sizes(graph, metrics), mode.value(), options.jobs);
+    }
+    switch (options.format) {
+    case Format::DOT:
+        graph_write_dot(graph, out, layout ? &layout.value() : nullptr);
+        break;
+    case Format::SVG:
+        graph_write_svg(graph, layout.value(), out);
+        break;
+    case Format::JSON:
+    case Format::JSONL:
+        graph_write_json(graph, options.format == Format::JSONL, out);
+        break;
+    case Format::COMPILED:
+        graph_write_compiled(graph, out);
+        break;
+    default:
+        graph_print(graph, out);
+    }
+}
+
+namespace {
+
+/* everything is formatted into buf, which is written out whenever it gets
+ * big, like graph_print does. G is a Graph, or a GraphBuilder when streaming:
+ * then the nodes that are looked at are those of the same top-level form,
+ * except for the types of what foreign keys link to. */
+template <typename G>
+class DotWriter {
+    static constexpr std::size_t flush_size = 64 * 1024;
+
+    const G &graph;
+    std::FILE *out;
+    const Layout *layout;
+    fmt::memory_buffer buf;
+
+    void append(std::string_view str) { buf.append(str.data(), str.data() + str.size()); }
+
+    // names are quoted, as they can have dashes in them.
+    void quoted(std::string_view str)
+    {
+        buf.push_back('"');
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                buf.push_back('\\');
+            buf.push_back(c);
+        }
+        buf.push_back('"');
+    }
+
+    // for html labels, which are the only ones that can underline.
+    void escaped(std::string_view str)
+    {
+        for (char c : str) {
+            switch (c) {
+            case '&': append("&amp;"); break;
+            case '<': append("&lt;");  break;
+            case '>': append("&gt;");  break;
+            default:  buf.push_back(c);
+            }
+        }
+    }
+
+    void declare(int id, std::string_view shape)
+    {
+        const Node &n = graph[id];
+        fmt::format_to(std::back_inserter(buf), "    n{} [shape={}, label=", id, shape);
+        quoted(n.anonymous ? "" : symbol_str(n.name));
+        position(id);
+        append("];\n");
+    }
+
+    // graphviz has y growing upwards, wants positions in points and sizes in
+    // inches.
+    void position(int id)
+    {
+        if (layout)
+            fmt::format_to(std::back_inserter(buf), ", pos=\"{:.0f},{:.0f}!\", width={:.2f}, height={:.2f}, fixedsize=true",
+                           layout->pos[id].x, layout->size.height - layout->pos[id].y,
+                           layout->sizes[id].width / 72, layout->sizes[id].height / 72);
+    }
+
+    void edge(int from, int to)
+    {
+        fmt::format_to(std::back_inserter(buf), "    n{} -- n{}", from, to);
+    }
+
+    void card_label(const Cardinality &card)
+    {
+        append(" [label=\"(");
+        append(card.first.to_string());
+        buf.push_back(',');
+        append(card.second.to_string());
+        append(")\"]");
+    }
+
+    // the cardinality of an attribute is one of its links.
+    void attr_edge(int owner, int attr)
+    {
+        edge(owner, attr);
+        for (int link : graph.links(attr)) {
+            if (graph[link].type == Node::Type::CARD) {
+                card_label(graph[link].info.card);
+                break;
+            }
+        }
+        append(";\n");
+    }
+
+    void attr_edges(int owner)
+    {
+        for (int link : graph.links(owner))
+            if (graph[link].type == Node::Type::ATTR)
+                attr_edge(owner, link);
+    }
+
+    void write_node(const Node &node)
+    {
+        auto links = graph.links(node.id);
+        switch (node.type) {
+        case Node::Type::ENTITY:
+            declare(node.id, "box");
+            attr_edges(node.id);
+            break;
+        case Node::Type::ATTR:
+            declare(node.id, "ellipse");
+            attr_edges(node.id);
+            break;
+        case Node::Type::ASSOC:
+            declare(node.id, "diamond");
+            // each participating entity comes through a cardinality node.
+            for (int link : links) {
+                const Node &l = graph[link];
+                if (l.type == Node::Type::CARD && !graph.links(link).empty()) {
+                    edge(node.id, graph.links(link)[0]);
+                    card_label(l.info.card);
+                    append(";\n");
+                } else if (l.type == Node::Type::ATTR)
+                    attr_edge(node.id, link);
+            }
+            break;
+        case Node::Type::PK:
+            // the attributes were already declared: this only changes their label.
+            for (int link : links) {
+                fmt::format_to(std::back_inserter(buf), "    n{} [label=<<u>", link);
+                escaped(symbol_str(graph[link].name));
+                append("</u>>];\n");
+            }
+            break;
+        case Node::Type::GERARCHY:
+            // the parser puts the parent, if any, first.
+            fmt::format_to(std::back_inserter(buf), "    n{} [shape=point, xlabel=", node.id);
+            quoted(gerarchy_type_to_string(node.info.gertype));
+            position(node.id);
+            append("];\n");
+            for (std::size_t i = 0; i < links.size(); i++) {
+                if (i == 0 && has_parent(node.info.gertype)) {
+                    edge(node.id, links[i]);
+                    append(" [dir=forward];\n");
+                } else {
+                    edge(links[i], node.id);
+                    append(";\n");
+                }
+            }
+            break;
+        case Node::Type::FK:
+            // from each referenced attribute to each object it's used in.
+            for (int attr : links) {
+                if (graph.type(attr) != Node::Type::ATTR)
+                    continue;
+                for (int target : links) {
+                    if (graph.type(target) == Node::Type::ATTR)
+                        continue;
+                    edge(attr, target);
+                    append(" [style=dashed, label=");
+                    quoted(node.anonymous ? "" : symbol_str(node.name));
+                    append("];\n");
+                }
+            }
+            break;
+        default:
+            // the start node isn't part of the diagram, and cardinalities are
+            // drawn by their parent.
+            break;
+        }
+    }
+
+public:
+    DotWriter(const G &g, std::FILE *f, const Layout *l) : graph(g), out(f), layout(l) { }
+
+    // the nodes from first up to last, after the start of the graph if open
+    // and before its end if close.
+    void write(int first, int last, bool open, bool close)
+    {
+        if (open)
+            fmt::format_to(std::back_inserter(buf), "graph er {{\n"
+                                                    "    node [fontname=\"Helvetica\", fontsize={}];\n"
+                                                    "    edge [fontname=\"Helvetica\", fontsize={}];\n",
+                           LABEL_FONT_SIZE, EDGE_FONT_SIZE);
+        for (int id = first; id < last; id++) {
+            write_node(graph[id]);
+            if (buf.size() >= flush_size) {
+                std::fwrite(buf.data(), 1, buf.size(), out);
+                buf.clear();
+            }
+        }
+        if (close)
+            append("}\n");
+        std::fwrite(buf.data(), 1, buf.size(), out);
+    }
+};
+
+}
+
+void graph_write_dot(const Graph &graph, std::FILE *out, const Layout *layout)
+{
+    DotWriter(graph, out, layout).write(0, graph.size(), true, true);
+}
+
+void graph_write_dot(const GraphBuilder &graph, int first, int last, bool open, bool close, std::FILE *out)
+{
+    DotWriter(graph, out, nullptr).write(first, last, open, close);
+}
+
+bool GraphStream::supports(const OutputOptions &options)
+{
+    return options.format == Format::JSON || options.format == Format::JSONL
+        || (options.format == Format::DOT && !options.layout);
+}
+
+void GraphStream::write(const GraphBuilder &graph, int first, int last, bool done)
+{
+    if (format == Format::DOT)
+        graph_write_dot(graph, first, last, !opened, done, out);
+    else
+        graph_write_json(graph, first, last, format == Format::JSONL, !opened, done, out);
+    opened = true;
+}
+
+} // namespace ER
@@ -0,0 +1,97 @@
+#ifndef OUTPUT_HPP_INCLUDED
+#define OUTPUT_HPP_INCLUDED
+
+#include <cstdio>
+#include <optional>
+#include <string_view>
+#include <er/graph.hpp>
+#include <er/layout.hpp>
+
+namespace ER {
+
+/* what gets written for a parsed diagram: the table of graph_print, a
+ * graphviz drawing of the diagram, the drawing itself, the graph as json,
+ * either as one document or one node per line, or the compiled graph. */
+enum class Format {
+    TABLE,
+    DOT,
+    SVG,
+    JSON,
+    JSONL,
+    COMPILED,
+};
+
+// font sizes of the labels of nodes and edges, in points.
+constexpr inline double LABEL_FONT_SIZE = 10;
+constexpr inline double EDGE_FONT_SIZE = 9;
+
+// for --format=name. returns nothing for unknown names.
+std::optional<Format> format_from_string(std::string_view name);
+// what batch runs add to the name of each input to name its output.
+std::string_view format_extension(Format format);
+
+struct OutputOptions {
+    Format format = Format::TABLE;
+    // where to put the nodes, for formats that can say it. without a layout,
+    // dot leaves it to whatever reads the output, and svg uses a layered one.
+    std::optional<LayoutMode> layout;
+    // threads for the layout.
+    unsigned jobs = 1;
+    // write nodes while parsing, see GraphStream.
+    bool stream = false;
+};
+
+void write_graph(const Graph &graph, const OutputOptions &options, std::FILE *out = stdout);
+
+/* writes the diagram as an undirected graphviz graph in chen notation:
+ * entities are boxes, associations diamonds and attributes ellipses, with
+ * key attributes underlined. cardinalities label the edges they belong to,
+ * and gerarchies are points with an arrow to the parent. the graph is walked
+ * once, in id order, and written through one buffer. given a layout, every
+ * node gets a pinned position, for neato -n. */
+void graph_write_dot(const Graph &graph, std::FILE *out = stdout, const Layout *layout = nullptr);
+
+/* draws the laid out diagram as an svg document, with the same shapes as the
+ * dot output. the document is streamed out through one buffer: edges are
+ * drawn in a first walk of the graph and nodes in a second one, so that the
+ * nodes cover the ends of the edges. */
+void graph_write_svg(const Graph &graph, const Layout &layout, std::FILE *out = stdout);
+
+/* writes every node of the graph as a json object with its id, type, name,
+ * anonymous flag and links, and its cardinality or gerarchy type when it has
+ * one. with lines, each node is a json document on a line of its own, so that
+ * the output can be split anywhere between lines; otherwise the nodes are in
+ * the "nodes" array of a single document. */
+void graph_write_json(const Graph &graph, bool lines, std::FILE *out = stdout);
+
+/* the same, for the nodes from first up to last of a graph that's still
+ * being built. the output is opened before them if open is set and closed
+ * after them if close is set. */
+void graph_write_dot(const GraphBuilder &graph, int first, int last, bool open, bool close, std::FILE *out);
+void graph_write_json(const GraphBuilder &graph, int first, int last, bool lines, bool open, bool close,
+                      std::FILE *out);
+
+/* writes a diagram while it's parsed instead of once its graph is built.
+ * the parser hands over the nodes of each top-level form as soon as the form
+ * is done, and drops them afterwards, so memory only grows with the names it
+ * keeps to resolve references. only formats that can be written a form at a
+ * time can be streamed: json, json lines, and dot without a layout. nodes
+ * come out in the order their forms end, so the start node is the last one
+ * instead of the first; dot output doesn't change. */
+class GraphStream {
+    Format format;
+    std::FILE *out;
+    bool opened = false;
+
+public:
+    GraphStream(Format f, std::FILE *o) : format(f), out(o) { }
+
+    static bool supports(const OutputOptions &options);
+    // the nodes from first up to last, which must be in graph. done is set for
+    // the last call, with the start node.
+    void write(const GraphBuilder &graph, int first, int last, bool done);
+};
+
+} // namespace ER
+
+#endif
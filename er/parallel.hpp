@@ -0,0 +1,61 @@
+#ifndef PARALLEL_HPP_INCLUDED
+#define PARALLEL_HPP_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ER {
+
+/* calls fn(i) for every i in [0, count) on jobs threads, the calling one
+ * included. each thread starts with its own contiguous share of the indices
+ * and works through it from the back; once it runs out, it steals from the
+ * front of the other shares, so threads only contend when one is out of work. */
+template <typename F>
+void stealing_for(std::size_t count, unsigned jobs, F &&fn)
+{
+    struct Share {
+        std::mutex lock;
+        std::size_t begin, end;
+    };
+    jobs = std::max<std::size_t>(1, std::min<std::size_t>(jobs, count));
+    std::vector<Share> shares(jobs);
+    for (unsigned i = 0; i < jobs; i++) {
+        shares[i].begin = count * i / jobs;
+        shares[i].end   = count * (i + 1) / jobs;
+    }
+    auto take = [&](unsigned self, std::size_t &task) {
+        {
+            std::lock_guard<std::mutex> guard{shares[self].lock};
+            if (shares[self].begin < shares[self].end) {
+                task = --shares[self].end;
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < jobs; i++) {
+            Share &victim = shares[(self + i) % jobs];
+            std::lock_guard<std::mutex> guard{victim.lock};
+            if (victim.begin < victim.end) {
+                task = victim.begin++;
+                return true;
+            }
+        }
+        return false;
+    };
+    auto worker = [&](unsigned self) {
+        for (std::size_t task; take(self, task); )
+            fn(task);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; i++)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for (auto &t : threads)
+        t.join();
+}
+
+} // namespace ER
+
+#endif
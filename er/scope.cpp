@@ -0,0 +1,66 @@
+#include <er/scope.hpp>
+
+namespace ER {
+
+void ScopeTable::close()
+{
+    for (std::size_t i = decls.size(); i > starts.back(); i--)
+        innermost[decls[i-1].name] = decls[i-1].shadowed;
+    decls.resize(starts.back());
+    starts.pop_back();
+}
+
+bool ScopeTable::declare(Symbol name, Node::Type type, int id)
+{
+    std::uint32_t scope = starts.size() - 1;
+    auto r = innermost.try_emplace(name, -1);
+    int &top = r.first->second;
+    if (top != -1 && decls[top].scope == scope)
+        return false;
+    decls.push_back({name, type, id, scope, top});
+    top = decls.size() - 1;
+    return true;
+}
+
+int ScopeTable::find(Symbol name, Node::Type type) const
+{
+    auto r = innermost.find(name);
+    for (int i = r != innermost.end() ? r->second : -1; i != -1; i = decls[i].shadowed)
+        if (decls[i].type == type)
+            return decls[i].id;
+    return -1;
+}
+
+int ScopeTable::find_in(std::size_t scope, Symbol name, Node::Type type) const
+{
+    auto r = innermost.find(name);
+    int i = r != innermost.end() ? r->second : -1;
+    while (i != -1 && decls[i].scope > scope)
+        i = decls[i].shadowed;
+    return i != -1 && decls[i].scope == scope && decls[i].type == type ? decls[i].id : -1;
+}
+
+void AttrIndex::add_entity(const GraphBuilder &graph, int entity)
+{
+    auto links = graph.links(entity);
+    if (links.size() < min_links)
+        return;
+    for (int i : links)
+        if (graph[i].type == Node::Type::ATTR)
+            attrs.try_emplace(key(entity, graph[i].name), i);
+}
+
+int AttrIndex::find(const GraphBuilder &graph, int entity, Symbol name) const
+{
+    auto links = graph.links(entity);
+    if (links.size() >= min_links) {
+        auto r = attrs.find(key(entity, name));
+        return r != attrs.end() ? r->second : -1;
+    }
+    for (int i : links)
+        if (graph[i].name == name && graph[i].type == Node::Type::ATTR)
+            return i;
+    return -1;
+}
+
+} // namespace ER
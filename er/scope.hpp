@@ -0,0 +1,81 @@
+#ifndef SCOPE_HPP_INCLUDED
+#define SCOPE_HPP_INCLUDED
+
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include <er/graph.hpp>
+#include <er/symbol.hpp>
+
+namespace ER {
+
+/* the names visible while parsing, for every open scope at once.
+ * a single table maps each name to its innermost declaration, and each
+ * declaration points to the one it shadows, if any. declarations are kept
+ * on a stack in the order they were made, so closing a scope pops the
+ * declarations made inside it and puts back the ones they were hiding.
+ * opening a scope only records where its declarations start.
+ * names are looked up by name alone, since a scope can't hold the same name
+ * twice, even with different types. */
+class ScopeTable {
+    struct Decl {
+        Symbol name;
+        Node::Type type;
+        int id;
+        std::uint32_t scope;
+        int shadowed;
+    };
+
+    // names are never removed from the table, they're set to -1 instead.
+    std::pmr::unordered_map<Symbol, int> innermost;
+    std::pmr::vector<Decl> decls;
+    std::pmr::vector<std::uint32_t> starts;
+
+public:
+    explicit ScopeTable(std::pmr::memory_resource *mem)
+        : innermost(mem), decls(mem), starts(mem)
+    { }
+
+    void open() { starts.push_back(decls.size()); }
+    void close();
+    std::size_t depth() const { return starts.size(); }
+
+    // returns false if the name is already declared in the current scope.
+    bool declare(Symbol name, Node::Type type, int id);
+    // the innermost declaration of name with the given type, or -1.
+    int find(Symbol name, Node::Type type) const;
+    // like find(), but only looks at the scope at the given depth (0 being the outermost).
+    int find_in(std::size_t scope, Symbol name, Node::Type type) const;
+};
+
+/* the attributes of wide entities, by entity id and name, so that
+ * (attr x entity) references don't have to scan the entity's links.
+ * entities with few links are quicker to scan than to index, so they're
+ * left out, unless every entity is asked for, as when the parser drops the
+ * nodes of each form and there's nothing left to scan. when an entity has
+ * two attributes with the same name, the first one is kept, as a scan
+ * would find. */
+class AttrIndex {
+    static const std::size_t MIN_INDEXED_LINKS = 32;
+
+    std::pmr::unordered_map<std::uint64_t, int> attrs;
+    std::size_t min_links;
+
+    static std::uint64_t key(int entity, Symbol name) { return std::uint64_t(std::uint32_t(entity)) << 32 | name; }
+
+public:
+    explicit AttrIndex(std::pmr::memory_resource *mem) : attrs(mem), min_links(MIN_INDEXED_LINKS) { }
+
+    // before any entity is added.
+    void index_all() { min_links = 0; }
+
+    // the links of the entity must already be in the graph.
+    void add_entity(const GraphBuilder &graph, int entity);
+    // returns the attribute of entity with the given name, or -1.
+    int find(const GraphBuilder &graph, int entity, Symbol name) const;
+};
+
+} // namespace ER
+
+#endif
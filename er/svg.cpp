@@ -0,0 +1,219 @@
+#include <er/output.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/format.h>
+
+namespace ER {
+
+namespace {
+
+/* like the dot writer, everything is formatted into buf, which is written
+ * out whenever it gets big. */
+class SvgWriter {
+    static constexpr std::size_t flush_size = 64 * 1024;
+
+    const Graph &graph;
+    const Layout &layout;
+    std::FILE *out;
+    fmt::memory_buffer buf;
+    // attributes that are part of a primary key, found while drawing edges,
+    // which get underlined when drawing nodes.
+    std::vector<bool> key;
+
+    void append(std::string_view str) { buf.append(str.data(), str.data() + str.size()); }
+
+    void flush_if_full()
+    {
+        if (buf.size() >= flush_size) {
+            std::fwrite(buf.data(), 1, buf.size(), out);
+            buf.clear();
+        }
+    }
+
+    void escaped(std::string_view str)
+    {
+        for (char c : str) {
+            switch (c) {
+            case '&': append("&amp;");  break;
+            case '<': append("&lt;");   break;
+            case '>': append("&gt;");   break;
+            case '"': append("&quot;"); break;
+            default:  buf.push_back(c);
+            }
+        }
+    }
+
+    Point at(int id) const { return layout.pos[id]; }
+
+    // text is centered on p. svg puts the baseline at y, so it's moved down
+    // by about half the height of lowercase letters.
+    void text(Point p, std::string_view str, std::string_view cls, double font_size)
+    {
+        fmt::format_to(std::back_inserter(buf), "<text{} x=\"{:.1f}\" y=\"{:.1f}\">", cls, p.x, p.y + font_size * 0.35);
+        escaped(str);
+        append("</text>\n");
+    }
+
+    void line(Point from, Point to, std::string_view cls = "")
+    {
+        fmt::format_to(std::back_inserter(buf), "<line{} x1=\"{:.1f}\" y1=\"{:.1f}\" x2=\"{:.1f}\" y2=\"{:.1f}\"/>\n",
+                       cls, from.x, from.y, to.x, to.y);
+    }
+
+    // where the line from the center of a box towards p leaves it.
+    Point box_border(int id, Point p) const
+    {
+        Point c = at(id);
+        double dx = p.x - c.x, dy = p.y - c.y;
+        double hw = layout.sizes[id].width / 2, hh = layout.sizes[id].height / 2;
+        if (dx == 0 && dy == 0)
+            return c;
+        double t = std::min(dx != 0 ? hw / std::abs(dx) : 1e300, dy != 0 ? hh / std::abs(dy) : 1e300);
+        return { c.x + dx * std::min(t, 1.0), c.y + dy * std::min(t, 1.0) };
+    }
+
+    void edge(int from, int to, std::string_view label = "", std::string_view cls = "")
+    {
+        line(at(from), at(to), cls);
+        if (!label.empty())
+            text({ (at(from).x + at(to).x) / 2, (at(from).y + at(to).y) / 2 }, label, " class=\"l\"", EDGE_FONT_SIZE);
+    }
+
+    static std::string card_label(const Cardinality &card)
+    {
+        return "(" + card.first.to_string() + "," + card.second.to_string() + ")";
+    }
+
+    void attr_edge(int owner, int attr)
+    {
+        for (int link : graph.links(attr)) {
+            if (graph[link].type == Node::Type::CARD) {
+                edge(owner, attr, card_label(graph[link].info.card));
+                return;
+            }
+        }
+        edge(owner, attr);
+    }
+
+    // the same edges as the dot output.
+    void write_edges(const Node &node)
+    {
+        auto links = graph.links(node.id);
+        switch (node.type) {
+        case Node::Type::ENTITY:
+        case Node::Type::ATTR:
+            for (int link : links)
+                if (graph[link].type == Node::Type::ATTR)
+                    attr_edge(node.id, link);
+            break;
+        case Node::Type::ASSOC:
+            for (int link : links) {
+                const Node &l = graph[link];
+                if (l.type == Node::Type::CARD && !graph.links(link).empty())
+                    edge(node.id, graph.links(link)[0], card_label(l.info.card));
+                else if (l.type == Node::Type::ATTR)
+                    attr_edge(node.id, link);
+            }
+            break;
+        case Node::Type::PK:
+            for (int link : links)
+                key[link] = true;
+            break;
+        case Node::Type::GERARCHY:
+            // the parser puts the parent, if any, first. the arrow has to end
+            // on the border of the parent, or the parent would hide it.
+            for (std::size_t i = 0; i < links.size(); i++) {
+                if (i == 0 && has_parent(node.info.gertype))
+                    line(at(node.id), box_border(links[i], at(node.id)), " marker-end=\"url(#arrow)\"");
+                else
+                    line(at(links[i]), at(node.id));
+            }
+            break;
+        case Node::Type::FK:
+            for (int attr : links) {
+                if (graph[attr].type != Node::Type::ATTR)
+                    continue;
+                for (int target : links)
+                    if (graph[target].type != Node::Type::ATTR)
+                        edge(attr, target, node.anonymous ? "" : symbol_str(node.name), " class=\"fk\"");
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void write_shape(const Node &node)
+    {
+        if (!is_drawn(node))
+            return;
+        Point c = at(node.id);
+        double w = layout.sizes[node.id].width, h = layout.sizes[node.id].height;
+        auto it = std::back_inserter(buf);
+        switch (node.type) {
+        case Node::Type::ENTITY:
+            fmt::format_to(it, "<rect x=\"{:.1f}\" y=\"{:.1f}\" width=\"{:.1f}\" height=\"{:.1f}\"/>\n",
+                           c.x - w / 2, c.y - h / 2, w, h);
+            break;
+        case Node::Type::ATTR:
+            fmt::format_to(it, "<ellipse cx=\"{:.1f}\" cy=\"{:.1f}\" rx=\"{:.1f}\" ry=\"{:.1f}\"/>\n", c.x, c.y, w / 2, h / 2);
+            break;
+        case Node::Type::ASSOC:
+            fmt::format_to(it, "<polygon points=\"{:.1f},{:.1f} {:.1f},{:.1f} {:.1f},{:.1f} {:.1f},{:.1f}\"/>\n",
+                           c.x, c.y - h / 2, c.x + w / 2, c.y, c.x, c.y + h / 2, c.x - w / 2, c.y);
+            break;
+        case Node::Type::GERARCHY:
+            fmt::format_to(it, "<circle cx=\"{:.1f}\" cy=\"{:.1f}\" r=\"{:.1f}\"/>\n", c.x, c.y, w / 2);
+            text({ c.x + w, c.y }, gerarchy_type_to_string(node.info.gertype), " class=\"g\"", EDGE_FONT_SIZE);
+            return;
+        default:
+            return;
+        }
+        if (!node.anonymous)
+            text(c, symbol_str(node.name), key[node.id] ? " class=\"k\"" : "", LABEL_FONT_SIZE);
+    }
+
+public:
+    SvgWriter(const Graph &g, const Layout &l, std::FILE *f) : graph(g), layout(l), out(f), key(g.size(), false) { }
+
+    void write()
+    {
+        fmt::format_to(std::back_inserter(buf),
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"{0:.0f}\" height=\"{1:.0f}\" viewBox=\"0 0 {0:.0f} {1:.0f}\" "
+            "font-family=\"Helvetica, Arial, sans-serif\" font-size=\"{2}\">\n"
+            "<style>\n"
+            "line {{ stroke: black; }}\n"
+            "rect, ellipse, polygon {{ stroke: black; fill: white; }}\n"
+            "text {{ text-anchor: middle; }}\n"
+            ".l, .g {{ font-size: {3}px; }}\n"
+            ".l {{ paint-order: stroke; stroke: white; stroke-width: 3px; }}\n"
+            ".g {{ text-anchor: start; }}\n"
+            ".k {{ text-decoration: underline; }}\n"
+            ".fk {{ stroke-dasharray: 4 3; }}\n"
+            "</style>\n"
+            "<defs><marker id=\"arrow\" viewBox=\"0 0 10 10\" refX=\"10\" refY=\"5\" markerWidth=\"8\" markerHeight=\"8\" orient=\"auto\">"
+            "<path d=\"M 0 0 L 10 5 L 0 10 z\"/></marker></defs>\n",
+            layout.size.width, layout.size.height, LABEL_FONT_SIZE, EDGE_FONT_SIZE);
+        for (const Node &node : graph) {
+            write_edges(node);
+            flush_if_full();
+        }
+        for (const Node &node : graph) {
+            write_shape(node);
+            flush_if_full();
+        }
+        append("</svg>\n");
+        std::fwrite(buf.data(), 1, buf.size(), out);
+    }
+};
+
+}
+
+void graph_write_svg(const Graph &graph, const Layout &layout, std::FILE *out)
+{
+    SvgWriter(graph, layout, out).write();
+}
+
+} // namespace ER
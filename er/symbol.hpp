@@ -0,0 +1,66 @@
+#ifndef SYMBOL_HPP_INCLUDED
+#define SYMBOL_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ER {
+
+/* a symbol is a handle to an interned string. the same name always gets
+ * the same symbol, so names can be compared and hashed as integers. */
+using Symbol = std::uint32_t;
+
+/* the strings themselves are copied once, the first time they're seen,
+ * into large blocks that never move. interning a name that was already
+ * seen doesn't allocate.
+ * the table is split into shards by hash, each with its own lock, so that
+ * files parsed on different threads rarely wait on each other. looking up
+ * the string of a symbol doesn't lock at all, since the names live in pages
+ * that are never moved once allocated. */
+class SymbolTable {
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr unsigned PAGE_BITS = 16;
+    static constexpr std::size_t PAGE_SIZE = std::size_t(1) << PAGE_BITS;
+    static constexpr std::size_t NUM_PAGES = std::size_t(1) << (32 - PAGE_BITS);
+    static constexpr std::size_t NUM_SHARDS = 16;
+
+    struct Shard {
+        std::mutex lock;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char *block_ptr = nullptr;
+        std::size_t block_left = 0;
+        std::unordered_map<std::string_view, Symbol> index;
+
+        std::string_view store(std::string_view name);
+    };
+
+    Shard shards[NUM_SHARDS];
+    std::atomic<std::uint32_t> count = 0;
+    std::mutex pages_lock;
+    std::vector<std::unique_ptr<std::string_view[]>> owned_pages;
+    std::atomic<std::string_view *> pages[NUM_PAGES] = {};
+
+    std::string_view *page_of(Symbol sym);
+
+public:
+    Symbol intern(std::string_view name);
+    std::string_view str(Symbol sym) const
+    {
+        return pages[sym >> PAGE_BITS].load(std::memory_order_acquire)[sym & (PAGE_SIZE - 1)];
+    }
+};
+
+// the symbol table shared by the whole program.
+SymbolTable &symbols();
+
+inline Symbol symbol_intern(std::string_view name) { return symbols().intern(name); }
+inline std::string_view symbol_str(Symbol sym)     { return symbols().str(sym); }
+
+} // namespace ER
+
+#endif
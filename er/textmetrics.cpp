@@ -0,0 +1,29 @@
+#include <er/textmetrics.hpp>
+
+namespace ER {
+
+// advance widths of helvetica for ' ' to '~', in thousandths of the font size.
+static const short helvetica[95] = {
+    278, 278, 355, 556, 556, 889, 667, 191, 333, 333, 389, 584, 278, 333, 278, 278,     //  !"#$%&'()*+,-./
+    556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 278, 278, 584, 584, 584, 556,     // 0123456789:;<=>?
+    1015, 667, 667, 722, 722, 667, 611, 778, 722, 278, 500, 667, 556, 833, 722, 778,    // @ABCDEFGHIJKLMNO
+    667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 278, 278, 278, 469, 556,     // PQRSTUVWXYZ[\]^_
+    333, 556, 556, 500, 556, 556, 278, 556, 556, 222, 222, 500, 222, 833, 556, 556,     // `abcdefghijklmno
+    556, 556, 333, 500, 278, 556, 500, 722, 500, 500, 500, 334, 260, 334, 584,          // pqrstuvwxyz{|}~
+};
+
+double TextMetrics::width(std::string_view text) const
+{
+    // anything outside ascii counts as one average character for each utf-8
+    // sequence, as continuation bytes are skipped.
+    long total = 0;
+    for (unsigned char c : text) {
+        if (c >= ' ' && c <= '~')
+            total += helvetica[c - ' '];
+        else if ((c & 0xC0) != 0x80)
+            total += 556;
+    }
+    return total * font_size / 1000;
+}
+
+} // namespace ER
@@ -0,0 +1,38 @@
+#ifndef TEXTMETRICS_HPP_INCLUDED
+#define TEXTMETRICS_HPP_INCLUDED
+
+#include <string_view>
+#include <vector>
+#include <er/symbol.hpp>
+
+namespace ER {
+
+/* widths of text set in helvetica, which is what the writers ask for, from
+ * the advance widths of its font metrics. no font is ever loaded, so the
+ * results are the same everywhere. diagrams use the same few names over and
+ * over (every entity has an id), so the width of each name is measured once
+ * and then remembered by symbol. not thread safe: each writer has its own. */
+class TextMetrics {
+    double font_size;
+    std::vector<float> memo;
+
+public:
+    explicit TextMetrics(double size) : font_size(size) { }
+
+    double size() const                 { return font_size; }
+    double width(std::string_view text) const;
+    double width(Symbol name)
+    {
+        if (name >= memo.size())
+            memo.resize(name + 1, -1);
+        if (memo[name] < 0)
+            memo[name] = width(symbol_str(name));
+        return memo[name];
+    }
+    // from the baseline of one line to the next.
+    double line_height() const          { return font_size * 1.2; }
+};
+
+} // namespace ER
+
+#endif
@@ -37,6 +37,16 @@ inline bool is_space(int c)
     return c == ' ' || c == '\t' || c == '\n' || c == '\r';
 }
 
+// Characters needed to print n in decimal.
+inline int count_digits(int n)
+{
+    unsigned u = n < 0 ? 0u - unsigned(n) : unsigned(n);
+    int digits = n < 0 ? 2 : 1;
+    for (; u >= 10; u /= 10)
+        digits++;
+    return digits;
+}
+
 template <typename T>
 std::string tostr(const T &x)
 {
@@ -0,0 +1,123 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <glob.h>
+#include <fmt/core.h>
+#include "input.hpp"
+#include "parallel.hpp"
+#include "parser.hpp"
+
+namespace fs = std::filesystem;
+
+bool names_many_files(std::string_view arg)
+{
+    std::error_code ec;
+    return arg.find_first_of("*?[") != arg.npos || fs::is_directory(arg, ec);
+}
+
+static void add_path(const std::string &path, std::vector<std::string> &files)
+{
+    std::error_code ec;
+    if (!fs::is_directory(path, ec)) {
+        files.push_back(path);
+        return;
+    }
+    std::vector<std::string> found;
+    for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+        if (it->is_regular_file(ec) && it->path().extension() == ".txt")
+            found.push_back(it->path().string());
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+std::vector<std::string> expand_inputs(std::span<char *const> args)
+{
+    std::vector<std::string> files;
+    for (const char *arg : args) {
+        glob_t matches;
+        if (std::strpbrk(arg, "*?[") && glob(arg, 0, nullptr, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; i++)
+                add_path(matches.gl_pathv[i], files);
+            globfree(&matches);
+        } else
+            add_path(arg, files);
+    }
+    return files;
+}
+
+namespace {
+
+struct Result {
+    bool ok = false;
+    double ms = 0;
+    std::string diagnostics;
+};
+
+}
+
+static Result process(const std::string &path, bool check)
+{
+    Result res;
+    auto input = Input::open(path);
+    if (!input)
+        return res;
+    if (check) {
+        res.ok = check_diagram(input->text(), path, &res.diagnostics);
+        return res;
+    }
+    // A stale output would look like the result of this run.
+    auto out_path = path + ".out";
+    auto graph = parse_diagram(input->text(), path, &res.diagnostics);
+    if (!graph) {
+        std::remove(out_path.c_str());
+        return res;
+    }
+    std::FILE *out = std::fopen(out_path.c_str(), "w");
+    if (!out) {
+        res.diagnostics += fmt::format("error: couldn't write {}: {}\n", out_path, std::strerror(errno));
+        return res;
+    }
+    print_graph(graph.value(), out);
+    res.ok = !std::ferror(out);
+    res.ok &= std::fclose(out) == 0;
+    if (!res.ok)
+        res.diagnostics += fmt::format("error: couldn't write {}\n", out_path);
+    return res;
+}
+
+int run_batch(const std::vector<std::string> &files, unsigned jobs, bool check)
+{
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    std::vector<Result> results(files.size());
+    stealing_for(files.size(), jobs, [&](size_t i) {
+        auto file_start = steady_clock::now();
+        results[i] = process(files[i], check);
+        results[i].ms = duration<double, std::milli>(steady_clock::now() - file_start).count();
+    });
+    double wall = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    size_t failed = 0;
+    double busy = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        const Result &res = results[i];
+        fmt::print("{} {:8.1f} ms  {}\n", res.ok ? "ok  " : "FAIL", res.ms, files[i]);
+        // Indented under their file, as they don't name it.
+        std::string_view errors = res.diagnostics;
+        while (!errors.empty()) {
+            size_t nl = std::min(errors.find('\n'), errors.size());
+            fmt::print("    {}\n", errors.substr(0, nl));
+            errors.remove_prefix(std::min(nl + 1, errors.size()));
+        }
+        failed += !res.ok;
+        busy += res.ms;
+    }
+    fmt::print("{} files, {} ok, {} failed, in {:.1f} ms ({:.1f} ms of work on {} threads)\n",
+               files.size(), files.size() - failed, failed, wall, busy, jobs);
+    return failed != 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Whether a command line argument stands for more than one file: a directory,
+// or a pattern with wildcards.
+bool names_many_files(std::string_view arg);
+
+// The files named by the arguments of a batch run, in order. Directories are
+// searched recursively for .txt files, and patterns are expanded like the
+// shell would, for when they come quoted. Arguments that name nothing are
+// kept as they are, so that they get reported as failures.
+std::vector<std::string> expand_inputs(std::span<char *const> args);
+
+// Parses every file on its own, on jobs threads. The graph of each file is
+// written to the file's path plus ".out"; when only checking, nothing is
+// written. Once all files are done, prints how each of them went and how long
+// it all took. Returns the exit status: 1 if any file failed.
+int run_batch(const std::vector<std::string> &files, unsigned jobs, bool check);
@@ -0,0 +1,180 @@
+// Times keyword recognition: the perfect hash of the lexer against the switch
+// trie it replaced, kept here as it was. Both look at the same identifiers,
+// taken from the file given on the command line, or from a generated diagram
+// with the usual mix of keywords and names if there's none.
+//
+//     make bench && debug/keyword-bench [file]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+#include "../input.hpp"
+#include "../lexer.hpp"
+#include "../util.hpp"
+
+namespace {
+
+Token::Type check_keyword(std::string_view word, size_t st, std::string_view rest, Token::Type type)
+{
+    return word.size() == st + rest.size() && rest == word.substr(st)
+        ? type
+        : Token::Type::Ident;
+}
+
+Token::Type check_two_keywords(std::string_view word, size_t st, std::string_view first, std::string_view second,
+                               Token::Type type)
+{
+    return (word.size() == st + first.size()  && first  == word.substr(st))
+        || (word.size() == st + second.size() && second == word.substr(st))
+        ? type
+        : Token::Type::Ident;
+}
+
+// The old Lexer::get_ident_type, including its mistakes ("fk" is PK, "card"
+// isn't a keyword), which don't matter for timing.
+Token::Type trie_keyword_type(std::string_view word)
+{
+    auto size = word.size();
+    switch (word[0]) {
+    case 'a':
+        if (size > 1) {
+            switch (word[1]) {
+            case 't': return check_two_keywords(word, 2, "tr", "tribute", Token::Type::Attr);
+            case 's': return check_two_keywords(word, 2, "soc", "sociation", Token::Type::Assoc);
+            }
+        }
+        break;
+    case 'b': return check_keyword(word, 1, "etween", Token::Type::Between);
+    case 'c': return check_keyword(word, 1, "hild", Token::Type::Child);
+    case 'e':
+        if (size > 1) {
+            switch (word[1]) {
+            case 'n': return check_keyword(word, 2, "tity", Token::Type::Entity);
+            case 'x': return check_keyword(word, 2, "clusive", Token::Type::Exclusive);
+            }
+        }
+        return check_keyword(word, 1, "ntity", Token::Type::Entity);
+    case 'f':
+        if (size > 1) {
+            switch (word[1]) {
+            case 'k': return size == 2 ? Token::Type::PK : Token::Type::Ident;
+            case 'o': return check_keyword(word, 2, "reign-key", Token::Type::FK);
+            }
+        }
+        break;
+    case 'g': return check_keyword(word, 1, "erarchy", Token::Type::Gerarchy);
+    case 'o': return check_keyword(word, 1, "verlapped", Token::Type::Overlapped);
+    case 'p':
+        if (size > 1) {
+            switch (word[1]) {
+            case 'k': return size == 2 ? Token::Type::PK : Token::Type::Ident;
+            case 'r': return check_keyword(word, 2, "imary-key", Token::Type::PK);
+            case 'a':
+                if (size > 3 && word[2] == 'r') {
+                    switch (word[3]) {
+                    case 't': return check_keyword(word, 4, "ial", Token::Type::Partial);
+                    case 'e': return check_keyword(word, 4, "nt",  Token::Type::Parent);
+                    }
+                }
+            }
+        }
+        break;
+    case 's': return check_keyword(word, 1, "ubset", Token::Type::Subset);
+    case 't':
+        if (size > 1) {
+            switch (word[1]) {
+            case 'o': return check_keyword(word, 2, "tal", Token::Type::Total);
+            case 'y': return check_keyword(word, 2, "pe",  Token::Type::Type);
+            }
+        }
+    }
+    return Token::Type::Ident;
+}
+
+// Same shape as the generated diagrams used elsewhere: entities with a few
+// attributes and a key, associations between them and foreign keys.
+std::string generate_diagram(int entities)
+{
+    std::string text;
+    for (int i = 0; i < entities; i++) {
+        text += fmt::format("(entity person-{} (attr id) (attr name) (attribute surname) (attr born 0 1) "
+                            "(pk id))\n", i);
+        if (i > 0) {
+            text += fmt::format("(association owns-{} (entity person-{} 0 N) (entity person-{} 1 1) "
+                                "(attr since))\n", i, i, i - 1);
+            text += fmt::format("(fk ref-{} (attr id person-{}) (association owns-{}))\n", i, i - 1, i);
+        }
+    }
+    return text;
+}
+
+// Words the lexer would hand to keyword recognition.
+std::vector<std::string_view> identifiers(std::string_view text)
+{
+    std::vector<std::string_view> words;
+    for (size_t i = 0; i < text.size(); ) {
+        if (!is_alpha(text[i])) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < text.size() && (is_alpha(text[i]) || is_digit(text[i])))
+            i++;
+        words.push_back(text.substr(start, i - start));
+    }
+    return words;
+}
+
+// Best of a few runs, in nanoseconds per word.
+template <typename F>
+double time_lookups(const std::vector<std::string_view> &words, F lookup, u64 &sum)
+{
+    using namespace std::chrono;
+    double best = 1e300;
+    for (int run = 0; run < 7; run++) {
+        auto start = steady_clock::now();
+        for (auto w : words)
+            sum += u64(lookup(w));
+        best = std::min(best, duration<double, std::nano>(steady_clock::now() - start).count());
+    }
+    return best / words.size();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string generated;
+    std::optional<Input> input;
+    std::string_view text;
+    if (argc > 1) {
+        input = Input::open(argv[1]);
+        if (!input)
+            return 1;
+        text = input->text();
+    } else {
+        generated = generate_diagram(100000);
+        text = generated;
+    }
+    auto words = identifiers(text);
+    if (words.empty()) {
+        fmt::print(stderr, "no identifiers to look up\n");
+        return 1;
+    }
+
+    u64 sum = 0;
+    double trie = time_lookups(words, trie_keyword_type, sum);
+    double hash = time_lookups(words, keyword_type, sum);
+    double trie2 = time_lookups(words, trie_keyword_type, sum);
+    double hash2 = time_lookups(words, keyword_type, sum);
+    fmt::print("{} identifiers\n", words.size());
+    fmt::print("trie           {:.2f} ns/ident\n", std::min(trie, trie2));
+    fmt::print("perfect hash   {:.2f} ns/ident\n", std::min(hash, hash2));
+    // Keeps the lookups from being optimized away.
+    if (sum == 1)
+        fmt::print("\n");
+}
@@ -1,6 +1,9 @@
 #include "graph.hpp"
 
-#include <fmt/core.h>
+#include <cstring>
+#include <unordered_map>
+#include <tuple>
+#include <fmt/format.h>
 
 std::optional<CardinalityValue> CardinalityValue::from_string(std::string_view str)
 {
@@ -53,60 +56,266 @@ static int longest_name_width()
     return max->size();
 }
 
-int links_text_width(const auto &links)
+// Width of the links of a node as printed, without the brackets.
+static int links_text_width(std::span<const int> links)
 {
     if (links.empty())
         return 4; // "None"
     int w = 0;
     for (int x : links)
-        w += 2 + std::to_string(x).size();
+        w += 2 + count_digits(x);
     return w;
-};
+}
+
+// The printer reads nodes through these, so that it can print compiled graphs
+// the same way.
+static std::string_view name_of(const Graph &g, int id)                         { return symbol_to_string(g[id].name); }
+static std::string_view name_of(const CompiledGraph &g, int id)                 { return g.name(id); }
+static Node::Type type_of(const Graph &g, int id)                               { return g[id].type; }
+static Node::Type type_of(const CompiledGraph &g, int id)                       { return g.type(id); }
+static std::optional<Cardinality> cardinality_of(const Graph &g, int id)        { return g[id].cardinality; }
+static std::optional<Cardinality> cardinality_of(const CompiledGraph &g, int id) { return g.cardinality(id); }
+static std::optional<GerarchyType> gerarchy_type_of(const Graph &g, int id)     { return g[id].gerarchy_type; }
+static std::optional<GerarchyType> gerarchy_type_of(const CompiledGraph &g, int id) { return g.gerarchy_type(id); }
 
-void print_graph(const Graph &graph)
+// Widths of the name and links columns, in one pass over the nodes.
+static std::pair<int, int> column_widths(const auto &graph)
 {
-    const auto format_links = [](const std::vector<int> &links) {
-        if (links.empty())
-            return std::string("None");
-        std::string str;
-        str.reserve(links_text_width(links));
-        for (std::size_t i = 0; i < links.size() - 1; i++)
-            str += fmt::format("{}, ", links[i]);
-        return str + fmt::format("{}", links[links.size()-1]);
+    int name_width = 0, links_width = 0;
+    for (size_t id = 0; id < graph.size(); id++) {
+        name_width  = std::max<int>(name_width, name_of(graph, id).size());
+        links_width = std::max(links_width, links_text_width(graph.links(id)) + 2);
+    }
+    return { name_width, links_width };
+}
+
+static std::pair<int, int> column_widths_of(const Graph &g)         { return { g.name_column_width(), g.links_column_width() }; }
+static std::pair<int, int> column_widths_of(const CompiledGraph &g) { return column_widths(g); }
+
+void Graph::measure()
+{
+    std::tie(name_width, links_width) = column_widths(*this);
+}
+
+Graph GraphBuilder::freeze()
+{
+    Graph graph;
+    graph.offsets.resize(nodes.size() + 1);
+    for (size_t i = 0; i < nodes.size(); i++)
+        graph.offsets[i+1] = graph.offsets[i] + ranges[i].second;
+    graph.links_data.resize(graph.offsets.back());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        auto l = links(i);
+        std::copy(l.begin(), l.end(), graph.links_data.begin() + graph.offsets[i]);
+    }
+    graph.nodes = std::move(nodes);
+    *this = GraphBuilder{};
+    graph.measure();
+    return graph;
+}
+
+// Rows are formatted straight into one buffer, padding included, and the
+// buffer is written out whenever it gets big.
+static void print_any_graph(const auto &graph, std::FILE *out)
+{
+    constexpr size_t FLUSH_SIZE = 64 * 1024;
+    auto [name_width, links_width] = column_widths_of(graph);
+    int type_width = longest_name_width();
+    fmt::memory_buffer buf;
+    auto it = std::back_inserter(buf);
+    const auto pad = [&](size_t used, int width) {
+        if (used < size_t(width)) {
+            size_t at = buf.size();
+            buf.resize(at + width - used);
+            std::memset(buf.data() + at, ' ', width - used);
+        }
     };
+    const auto append = [&](std::string_view str) { buf.append(str.data(), str.data() + str.size()); };
+
+    fmt::format_to(it, "{:3} {:{}} {:{}} {:{}} Additional information\n",
+                   "ID", "Name", name_width, "Type", type_width, "Links", links_width);
+    for (size_t id = 0; id < graph.size(); id++) {
+        fmt::format_to(it, "{:3} ", id);
+        auto name = name_of(graph, id);
+        append(name);
+        pad(name.size(), name_width);
+        buf.push_back(' ');
+        auto type = node_type_to_string(type_of(graph, id));
+        append(type);
+        pad(type.size(), type_width);
+        buf.push_back(' ');
+
+        auto links = graph.links(id);
+        size_t links_at = buf.size();
+        buf.push_back('[');
+        for (size_t i = 0; i < links.size(); i++) {
+            if (i != 0)
+                append(", ");
+            fmt::format_to(it, "{}", links[i]);
+        }
+        if (links.empty())
+            append("None");
+        buf.push_back(']');
+        pad(buf.size() - links_at, links_width);
+        buf.push_back(' ');
+
+        auto card = cardinality_of(graph, id);
+        auto gerarchy = gerarchy_type_of(graph, id);
+        if (card) {
+            append("Cardinality values: ");
+            append(card.value().first.to_string());
+            buf.push_back(':');
+            append(card.value().second.to_string());
+        }
+        if (gerarchy) {
+            append("Gerarchy type: ");
+            append(gerarchy_type_to_string(gerarchy.value()));
+        }
+        if (!card && !gerarchy)
+            append("None");
+        buf.push_back('\n');
+        if (buf.size() >= FLUSH_SIZE) {
+            std::fwrite(buf.data(), 1, buf.size(), out);
+            buf.clear();
+        }
+    }
+    std::fwrite(buf.data(), 1, buf.size(), out);
+}
+
+void print_graph(const Graph &graph, std::FILE *out)         { print_any_graph(graph, out); }
+void print_graph(const CompiledGraph &graph, std::FILE *out) { print_any_graph(graph, out); }
 
-    const auto format_info = [](const Node &node) -> std::string {
-        std::string info = "";
-        if (node.cardinality)
-            info += fmt::format("Cardinality values: {}:{}",
-                node.cardinality.value().first.to_string(),
-                node.cardinality.value().second.to_string());
+static u32 compile_card(CardinalityValue value)
+{
+    return value.value ? u32(value.value.value()) : CompiledNode::CARD_MANY;
+}
+
+static CardinalityValue load_card(u32 value)
+{
+    return value == CompiledNode::CARD_MANY ? CardinalityValue(CARD_MANY) : CardinalityValue(int(value));
+}
+
+bool write_compiled_graph(const Graph &graph, std::FILE *out)
+{
+    std::vector<CompiledNode> nodes(graph.size());
+    std::string names;
+    std::unordered_map<Symbol, u32> name_at;
+    for (const Node &node : graph) {
+        auto name = symbol_to_string(node.name);
+        auto [it, inserted] = name_at.try_emplace(node.name, names.size());
+        if (inserted)
+            names += name;
+        CompiledNode &c = nodes[node.id];
+        c.name_at   = it->second;
+        c.name_size = name.size();
+        c.type      = u8(node.type);
+        if (node.cardinality) {
+            c.info |= CompiledNode::HAS_CARDINALITY;
+            c.cardinality[0] = compile_card(node.cardinality.value().first);
+            c.cardinality[1] = compile_card(node.cardinality.value().second);
+        }
         if (node.gerarchy_type)
-            info += fmt::format("Gerarchy type: {}", gerarchy_type_to_string(node.gerarchy_type.value()));
-        return info.empty() ? "None" : info;
+            c.info |= CompiledNode::HAS_GERARCHY | node.gerarchy_type.value();
+    }
+
+    auto offsets = graph.link_offsets();
+    auto links = graph.all_links();
+    const auto align = [](u64 n) { return (n + 7) & ~u64(7); };
+    CompiledHeader header = {};
+    std::memcpy(header.magic, CompiledHeader::MAGIC, sizeof(header.magic));
+    header.byte_order = CompiledHeader::ORDER_MARK;
+    header.version    = CompiledHeader::VERSION;
+    header.num_nodes  = nodes.size();
+    header.num_links  = links.size();
+    header.names_size = names.size();
+    header.nodes_at   = align(sizeof(header));
+    header.offsets_at = align(header.nodes_at + nodes.size() * sizeof(CompiledNode));
+    header.links_at   = align(header.offsets_at + offsets.size_bytes());
+    header.names_at   = align(header.links_at + links.size_bytes());
+
+    u64 written = 0;
+    const auto write_at = [&](u64 at, const void *data, size_t size) {
+        static const char zeros[8] = {};
+        std::fwrite(zeros, 1, at - written, out);
+        std::fwrite(data, 1, size, out);
+        written = at + size;
     };
+    write_at(0, &header, sizeof(header));
+    write_at(header.nodes_at, nodes.data(), nodes.size() * sizeof(CompiledNode));
+    write_at(header.offsets_at, offsets.data(), offsets.size_bytes());
+    write_at(header.links_at, links.data(), links.size_bytes());
+    write_at(header.names_at, names.data(), names.size());
+    return !std::ferror(out);
+}
 
-    const auto max_link_width = [](const Graph &g) {
-        auto it = std::max_element(g.begin(), g.end(), [&](const auto &p, const auto &q) {
-            return links_text_width(p.second.links) < links_text_width(q.second.links);
-        });
-        return it != g.end() ? links_text_width(it->second.links) + 2 : 0;
+bool CompiledGraph::is_compiled(std::string_view text)
+{
+    return text.starts_with(std::string_view(CompiledHeader::MAGIC, sizeof(CompiledHeader::MAGIC)));
+}
+
+std::optional<CompiledGraph> CompiledGraph::load(Input &&input, std::string_view path)
+{
+    const auto fail = [&](std::string_view why) -> std::optional<CompiledGraph> {
+        fmt::print(stderr, "error: {}: {}\n", path, why);
+        return std::nullopt;
+    };
+    auto text = input.text();
+    if (text.size() < sizeof(CompiledHeader) || !is_compiled(text))
+        return fail("not a compiled graph");
+    // Mapped files start on a page, and buffers come from the heap.
+    if (reinterpret_cast<uintptr_t>(text.data()) % alignof(CompiledHeader) != 0)
+        return fail("compiled graph isn't aligned in memory");
+    const auto &header = *reinterpret_cast<const CompiledHeader *>(text.data());
+    if (header.byte_order != CompiledHeader::ORDER_MARK)
+        return fail("compiled graph was written with a different byte order");
+    if (header.version != CompiledHeader::VERSION)
+        return fail(fmt::format("unsupported compiled graph version {}", header.version));
+    const auto fits = [&](u64 at, u64 count, size_t size) {
+        return at % 4 == 0 && at <= text.size() && count <= (text.size() - at) / size;
     };
+    if (!fits(header.nodes_at, header.num_nodes, sizeof(CompiledNode))
+     || !fits(header.offsets_at, u64(header.num_nodes) + 1, sizeof(u32))
+     || !fits(header.links_at, header.num_links, sizeof(int))
+     || !fits(header.names_at, header.names_size, 1))
+        return fail("compiled graph is truncated");
 
-    int name_width = std::max_element(graph.begin(), graph.end(), [](const auto &p, const auto &q) {
-        return p.second.name.size() < q.second.name.size();
-    })->second.name.size();
-    int type_width = longest_name_width();
-    int links_width = max_link_width(graph);
-
-    fmt::print("{:3} {:{}} {:{}} {:{}} Additional information\n",
-               "ID", "Name", name_width, "Type", type_width, "Links", links_width);
-    for (const auto &p : graph) {
-        fmt::print("{:3} {:{}} {:{}} {:{}} {}\n",
-                   p.second.id,
-                   p.second.name, name_width,
-                   node_type_to_string(p.second.type), type_width,
-                   "[" + format_links(p.second.links) + "]", links_width,
-                   format_info(p.second));
+    CompiledGraph graph;
+    graph.input      = std::move(input);
+    const char *base = graph.input.data();
+    graph.nodes      = { reinterpret_cast<const CompiledNode *>(base + header.nodes_at), header.num_nodes };
+    graph.offsets    = { reinterpret_cast<const u32 *>(base + header.offsets_at), header.num_nodes + size_t(1) };
+    graph.links_data = { reinterpret_cast<const int *>(base + header.links_at), header.num_links };
+    graph.names      = { base + header.names_at, header.names_size };
+
+    // One pass over the tables, without building anything.
+    if (graph.offsets.front() != 0 || graph.offsets.back() != header.num_links)
+        return fail("compiled graph is damaged");
+    for (size_t i = 0; i < graph.nodes.size(); i++) {
+        const CompiledNode &node = graph.nodes[i];
+        if (graph.offsets[i] > graph.offsets[i+1]
+         || node.type > u8(Node::Type::Card)
+         || node.name_at > graph.names.size() || node.name_size > graph.names.size() - node.name_at)
+            return fail("compiled graph is damaged");
     }
+    // -1 stands for primary keys naming a missing attribute.
+    for (int link : graph.links_data)
+        if (link < -1 || link >= int(header.num_nodes))
+            return fail("compiled graph is damaged");
+    return graph;
+}
+
+std::optional<Cardinality> CompiledGraph::cardinality(int id) const
+{
+    const CompiledNode &node = nodes[id];
+    if (!(node.info & CompiledNode::HAS_CARDINALITY))
+        return std::nullopt;
+    return std::make_pair(load_card(node.cardinality[0]), load_card(node.cardinality[1]));
+}
+
+std::optional<GerarchyType> CompiledGraph::gerarchy_type(int id) const
+{
+    const CompiledNode &node = nodes[id];
+    if (!(node.info & CompiledNode::HAS_GERARCHY))
+        return std::nullopt;
+    return GerarchyType(node.info & ~(CompiledNode::HAS_CARDINALITY | CompiledNode::HAS_GERARCHY));
 }
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <algorithm>
-#include <map>
+#include <cstdint>
+#include <cstdio>
+#include <span>
 #include <string>
 #include <vector>
 #include <optional>
+#include "input.hpp"
 #include "util.hpp"
+#include "symbol.hpp"
 
 struct CardinalityManyType {};
 constexpr inline CardinalityManyType CARD_MANY;
@@ -68,20 +72,161 @@ struct Node {
 #undef O
     } type;
     int id;
-    std::string name;
-    std::vector<int> links;
+    Symbol name;
     std::optional<Cardinality> cardinality;
     std::optional<GerarchyType> gerarchy_type;
 
     Node() = default;
-    Node(Node::Type t, int i, std::string_view n, std::vector<int> &&l)
-        : type(t), id(i), name(std::string{n}), links(std::move(l)),
+    Node(Node::Type t, int i, Symbol n)
+        : type(t), id(i), name(n),
           cardinality(std::nullopt), gerarchy_type(std::nullopt)
     { }
 };
 
 std::string node_type_to_string(Node::Type type);
 
-using Graph = std::map<int, Node>;
+// A finished graph. Ids go from 0 to size()-1, so nodes are kept in a vector
+// indexed by id. Links are stored in compressed sparse row form: the links of
+// node i are links_data[offsets[i]] up to links_data[offsets[i+1]].
+class Graph {
+    std::vector<Node> nodes;
+    std::vector<u32> offsets = {0};
+    std::vector<int> links_data;
+    // Widths of the name and links columns of print_graph, measured when the
+    // graph is complete so that printing takes a single pass.
+    int name_width = 0;
+    int links_width = 0;
+
+    void measure();
+
+    friend class GraphBuilder;
+
+public:
+    Graph() = default;
+    // For graphs laid out elsewhere: offsets must have one more element than
+    // nodes, ending with the size of links.
+    Graph(std::vector<Node> &&n, std::vector<u32> &&o, std::vector<int> &&l)
+        : nodes(std::move(n)), offsets(std::move(o)), links_data(std::move(l))
+    {
+        measure();
+    }
+
+    size_t size() const                         { return nodes.size(); }
+    const Node & operator[](int id) const       { return nodes[id]; }
+    std::span<const int> links(int id) const    { return { links_data.data() + offsets[id], links_data.data() + offsets[id+1] }; }
+    std::span<const u32> link_offsets() const   { return offsets; }
+    std::span<const int> all_links() const      { return links_data; }
+    int name_column_width() const               { return name_width; }
+    int links_column_width() const              { return links_width; }
+    auto begin() const                          { return nodes.begin(); }
+    auto end() const                            { return nodes.end(); }
+};
+
+// Builds a Graph while parsing. Nodes can be added in any order, and their
+// links can be added separately from them. Every id from 0 up to the biggest
+// one must have been added before freezing.
+class GraphBuilder {
+    std::vector<Node> nodes;
+    std::vector<std::pair<u32, u32>> ranges; // Where the links of each id are in pending
+    std::vector<int> pending;
+
+    void grow(int id)
+    {
+        if (size_t(id) >= nodes.size()) {
+            nodes.resize(id + 1);
+            ranges.resize(id + 1);
+        }
+    }
+
+public:
+    Node & add(const Node &node)                { grow(node.id); return nodes[node.id] = node; }
+    void add_links(int id, std::span<const int> links)
+    {
+        grow(id);
+        ranges[id] = { u32(pending.size()), u32(links.size()) };
+        pending.insert(pending.end(), links.begin(), links.end());
+    }
+
+    const Node & operator[](int id) const       { return nodes[id]; }
+    size_t num_links() const                    { return pending.size(); }
+    std::span<const int> links(int id) const
+    {
+        return size_t(id) < ranges.size() ? std::span<const int>{ pending.data() + ranges[id].first, ranges[id].second }
+                                          : std::span<const int>{};
+    }
+
+    // Leaves the builder empty.
+    Graph freeze();
+};
+
+// The compiled form of a graph, for tools that need the graph of a diagram
+// without parsing it again. It's laid out to be mapped and used in place: a
+// header, a table of nodes indexed by id, the link offsets and links exactly
+// as Graph keeps them, and a pool with the name of every node, each name
+// stored once. Sections start on 8 byte boundaries. Numbers are in the byte
+// order of the machine that wrote the file, which the header records. erlisp
+// writes and reads the same files (see er/graph.hpp).
+struct CompiledHeader {
+    static constexpr char MAGIC[8] = "ERGRAPH";
+    static constexpr u32 ORDER_MARK = 0x01020304;
+    static constexpr u32 VERSION = 1;
+
+    char magic[8];
+    u32 byte_order;
+    u32 version;
+    u32 num_nodes;
+    u32 num_links;
+    u64 names_size;
+    u64 nodes_at;   // Where each section starts, from the start of the file
+    u64 offsets_at;
+    u64 links_at;
+    u64 names_at;
+};
+
+struct CompiledNode {
+    static constexpr u8 HAS_CARDINALITY = 1 << 6;
+    static constexpr u8 HAS_GERARCHY    = 1 << 7;  // The GerarchyType is in the low bits of info
+    static constexpr u32 CARD_MANY      = UINT32_MAX;
+
+    u32 name_at;    // In the name pool
+    u32 name_size;
+    u8 type;
+    u8 info;
+    u16 unused;
+    u32 cardinality[2];
+};
+
+static_assert(sizeof(CompiledHeader) == 64 && sizeof(CompiledNode) == 20);
+
+// Returns false if the file couldn't be written.
+bool write_compiled_graph(const Graph &graph, std::FILE *out);
+
+// A compiled graph, mapped from its file. Nothing is copied or converted when
+// it's loaded: the accessors read the mapped tables in place. The tables are
+// checked once when loading, so that a damaged file can't send them out of
+// bounds.
+class CompiledGraph {
+    Input input; // Moving it doesn't move the text, so the views stay valid
+    std::span<const CompiledNode> nodes;
+    std::span<const u32> offsets;
+    std::span<const int> links_data;
+    std::string_view names;
+
+    CompiledGraph() = default;
+
+public:
+    // Whether the text of a file is a compiled graph rather than a diagram.
+    static bool is_compiled(std::string_view text);
+    // Errors are reported here, and nullopt returned.
+    static std::optional<CompiledGraph> load(Input &&input, std::string_view path);
+
+    size_t size() const                         { return nodes.size(); }
+    Node::Type type(int id) const               { return Node::Type(nodes[id].type); }
+    std::string_view name(int id) const         { return names.substr(nodes[id].name_at, nodes[id].name_size); }
+    std::optional<Cardinality> cardinality(int id) const;
+    std::optional<GerarchyType> gerarchy_type(int id) const;
+    std::span<const int> links(int id) const    { return links_data.subspan(offsets[id], offsets[id+1] - offsets[id]); }
+};
 
-void print_graph(const Graph &graph);
+void print_graph(const Graph &graph, std::FILE *out = stdout);
+void print_graph(const CompiledGraph &graph, std::FILE *out = stdout);
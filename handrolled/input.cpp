@@ -0,0 +1,102 @@
+#include "input.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fmt/core.h>
+
+Input & Input::operator=(Input &&other)
+{
+    if (this != &other) {
+        if (map)
+            munmap(const_cast<char *>(map), maplen);
+        map    = std::exchange(other.map, nullptr);
+        maplen = std::exchange(other.maplen, 0);
+        len    = std::exchange(other.len, 0);
+        buf    = std::move(other.buf);
+    }
+    return *this;
+}
+
+Input::~Input()
+{
+    if (map)
+        munmap(const_cast<char *>(map), maplen);
+}
+
+// Map the file over a zeroed anonymous mapping one byte larger than the file:
+// the tail of the last file page is zeroed by the kernel, and a file ending on
+// a page boundary is followed by the anonymous page, so the sentinel is always
+// there.
+bool Input::map_file(int fd, size_t size)
+{
+    size_t page  = sysconf(_SC_PAGESIZE);
+    size_t total = (size + 1 + page - 1) / page * page;
+    void *base = mmap(nullptr, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return false;
+    if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, total);
+        return false;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+    map    = static_cast<const char *>(base);
+    maplen = total;
+    len    = size;
+    return true;
+}
+
+bool Input::read_file(int fd, size_t size_hint)
+{
+    const size_t chunk = 64 * 1024;
+    buf.resize(std::max(size_hint, chunk));
+    for (;;) {
+        if (len == buf.size())
+            buf.resize(buf.size() * 2);
+        ssize_t n = ::read(fd, buf.data() + len, buf.size() - len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (n == 0)
+            break;
+        len += n;
+    }
+    buf.resize(len);
+    return true;
+}
+
+std::optional<Input> Input::load(std::string_view pathname, bool may_map)
+{
+    bool use_stdin = pathname == "-";
+    std::string path{pathname};
+    int fd = use_stdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fmt::print(stderr, "error: {}: {}\n", path, std::strerror(errno));
+        return std::nullopt;
+    }
+
+    Input input;
+    struct stat st;
+    bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    bool ok = (may_map && regular && st.st_size > 0 && input.map_file(fd, st.st_size))
+           || input.read_file(fd, regular ? st.st_size : 0);
+    int err = errno;
+    if (!use_stdin)
+        close(fd);
+    if (!ok) {
+        fmt::print(stderr, "error: {}: {}\n", path, std::strerror(err));
+        return std::nullopt;
+    }
+    if (input.size() >= MAX_SIZE) {
+        fmt::print(stderr, "error: {}: input is too large: only files up to 4 GiB are supported\n", path);
+        return std::nullopt;
+    }
+    return input;
+}
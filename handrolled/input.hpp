@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/*
+ * The text of a diagram. Regular files are mapped read-only into memory and
+ * never copied; anything else (pipes, stdin) is read into a buffer. Either
+ * way, the byte right after the text is always '\0', so the lexer may peek one
+ * character past the end. The pathname "-" means stdin.
+ * Token and line offsets are 32 bits, so inputs of MAX_SIZE bytes or more are
+ * refused.
+ */
+class Input {
+    const char *map = nullptr;
+    size_t maplen = 0;
+    size_t len = 0;
+    std::string buf;
+
+    bool map_file(int fd, size_t size);
+    bool read_file(int fd, size_t size_hint);
+    static std::optional<Input> load(std::string_view pathname, bool may_map);
+
+public:
+    static constexpr size_t MAX_SIZE = UINT32_MAX;
+
+    Input() = default;
+    Input(const Input &) = delete;
+    Input & operator=(const Input &) = delete;
+    Input(Input &&other) { *this = std::move(other); }
+    Input & operator=(Input &&other);
+    ~Input();
+
+    static std::optional<Input> open(std::string_view pathname) { return load(pathname, true); }
+    // Always reads the file into a buffer of its own, for files that may be
+    // truncated while they're used: a shrinking mapping would fault.
+    static std::optional<Input> read(std::string_view pathname) { return load(pathname, false); }
+
+    bool mapped() const             { return map != nullptr; }
+    const char *data() const        { return mapped() ? map : buf.c_str(); }
+    size_t size() const             { return len; }
+    std::string_view text() const   { return { data(), len }; }
+};
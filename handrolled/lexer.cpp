@@ -1,24 +1,33 @@
 #include "lexer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
 #include "util.hpp"
 
 std::string_view token_type_to_string(Token::Type t)
 {
     switch (t) {
-#define O(name) case Token::Type::name: return #name;
+#define O(name, ...) case Token::Type::name: return #name;
     TOKEN_TYPES(O)
 #undef O
     default: return "ERROR";
     }
 }
 
-std::pair<size_t, size_t> token_position(Token t, std::string_view text)
+std::pair<size_t, size_t> LineIndex::position(std::string_view text, size_t pos)
 {
-    auto tmp = text.substr(0, t.pos);
-    auto line = std::count(tmp.begin(), tmp.end(), '\n') + 1;
-    auto last_nl = tmp.find_last_of('\n');
-    auto column = t.pos - last_nl;
-    return std::make_pair(line, column);
+    if (starts.empty()) {
+        starts.reserve(text.size() / 32 + 1);
+        starts.push_back(0);
+        for (const char *p = text.data(), *end = p + text.size();
+             (p = (const char *) std::memchr(p, '\n', end - p)) != nullptr; p++)
+            starts.push_back(p - text.data() + 1);
+    }
+    auto line = std::upper_bound(starts.begin(), starts.end(), pos) - 1;
+    return std::make_pair(line - starts.begin() + 1, pos - *line + 1);
 }
 
 Token Lexer::make(Token::Type type)
@@ -55,7 +64,7 @@ void Lexer::skip_whitespace()
             advance();
             break;
         case ';':
-            while (peek() != '\n')
+            while (!at_end() && peek() != '\n')
                 advance();
             break;
         default:
@@ -71,82 +80,111 @@ Token Lexer::ident()
     return make(get_ident_type());
 }
 
-Token::Type Lexer::check_keyword(size_t st, std::string_view rest, Token::Type type)
+// Strings can't span lines and have no escapes; the token keeps the quotes.
+Token Lexer::string()
 {
-    return (cur - start == st + rest.size() && rest == text.substr(start+st, rest.size()))
-        ? type
-        : Token::Type::Ident;
+    while (!at_end() && peek() != '"' && peek() != '\n')
+        advance();
+    if (!match('"'))
+        return error("unterminated string");
+    return make(Token::Type::String);
 }
 
-Token::Type Lexer::check_two_keywords(size_t st, std::string_view first, std::string_view second, Token::Type type)
+/*
+ * Keywords are recognized with a perfect hash built at compile time from
+ * KEYWORD_TYPES. The hash only looks at the length and at the first, second
+ * and last characters, which are enough to tell all keywords apart; a seed is
+ * searched until no two keywords land in the same slot. Looking up an
+ * identifier is then one hash, one length compare and one memcmp.
+ */
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    Token::Type type = Token::Type::Ident;
+};
+
+#define O(name, ...) + std::size(std::initializer_list<std::string_view>{__VA_ARGS__})
+constexpr size_t NUM_KEYWORDS = 0 KEYWORD_TYPES(O);
+#undef O
+constexpr u32 KEYWORD_TABLE_BITS = 6;
+constexpr size_t KEYWORD_TABLE_SIZE = 1 << KEYWORD_TABLE_BITS;
+
+constexpr std::array<Keyword, NUM_KEYWORDS> keyword_list()
 {
-    return (cur - start == st + first.size()  && first  == text.substr(start+st, first.size()))
-        || (cur - start == st + second.size() && second == text.substr(start+st, second.size()))
-        ? type
-        : Token::Type::Ident;
-    // auto rest = text.substr(start, cur-start);
-    // return ((cur-start == start+first.size() && first == rest)
-    //     ||  (cur-start == start+second.size() && rest == rest)) ? type : Token::Type::Ident;
+    std::array<Keyword, NUM_KEYWORDS> list;
+    size_t n = 0;
+#define O(name, ...) for (auto text : {__VA_ARGS__}) list[n++] = Keyword{text, Token::Type::name};
+    KEYWORD_TYPES(O)
+#undef O
+    return list;
 }
 
-Token::Type Lexer::get_ident_type()
+constexpr auto KEYWORDS = keyword_list();
+
+constexpr size_t keyword_size(auto cmp)
 {
-    auto size = cur - start;
-    auto word = text.substr(start, text.size() - start);
-    switch (word[0]) {
-    case 'a':
-        if (size > 1) {
-            switch (word[1]) {
-            case 't': return check_two_keywords(2, "tr", "tribute", Token::Type::Attr);
-            case 's': return check_two_keywords(2, "soc", "sociation", Token::Type::Assoc);
-            }
-        }
-        break;
-    case 'b': return check_keyword(1, "etween", Token::Type::Between);
-    case 'c': return check_keyword(1, "hild", Token::Type::Child);
-    case 'e':
-        if (size > 1) {
-            switch (word[1]) {
-            case 'n': return check_keyword(2, "tity", Token::Type::Entity);
-            case 'x': return check_keyword(2, "clusive", Token::Type::Exclusive);
-            }
-        }
-              return check_keyword(1, "ntity", Token::Type::Entity);
-    case 'f':
-        if (size > 1) {
-            switch (word[1]) {
-            case 'k': return size == 2 ? Token::Type::PK : Token::Type::Ident;
-            case 'o': return check_keyword(2, "reign-key", Token::Type::FK);
-            }
-        }
-        break;
-    case 'g': return check_keyword(1, "erarchy", Token::Type::Gerarchy);
-    case 'o': return check_keyword(1, "verlapped", Token::Type::Overlapped);
-    case 'p':
-        if (size > 1) {
-            switch (word[1]) {
-            case 'k': return size == 2 ? Token::Type::PK : Token::Type::Ident;
-            case 'r': return check_keyword(2, "imary-key", Token::Type::PK);
-            case 'a':
-                if (size > 3 && word[2] == 'r') {
-                    switch (word[3]) {
-                    case 't': return check_keyword(4, "ial", Token::Type::Partial);
-                    case 'e': return check_keyword(4, "nt",  Token::Type::Parent);
-                    }
-                }
-            }
-        }
-        break;
-    case 's': return check_keyword(1, "ubset", Token::Type::Subset);
-    case 't':
-        if (size > 1) {
-            switch (word[1]) {
-            case 'o': return check_keyword(2, "tal", Token::Type::Total);
-            case 'y': return check_keyword(2, "pe",  Token::Type::Type);
-            }
+    size_t size = KEYWORDS[0].text.size();
+    for (auto k : KEYWORDS)
+        size = cmp(k.text.size(), size) ? k.text.size() : size;
+    return size;
+}
+
+constexpr size_t MIN_KEYWORD_SIZE = keyword_size(std::less{});
+constexpr size_t MAX_KEYWORD_SIZE = keyword_size(std::greater{});
+static_assert(MIN_KEYWORD_SIZE >= 2, "keyword hash reads the first two characters");
+
+constexpr u32 keyword_hash(std::string_view word, u32 seed)
+{
+    u32 h = seed ^ u32(word.size());
+    h = (h ^ u8(word[0]))             * 0x01000193;
+    h = (h ^ u8(word[1]))             * 0x01000193;
+    h = (h ^ u8(word[word.size()-1])) * 0x01000193;
+    return h >> (32 - KEYWORD_TABLE_BITS);
+}
+
+constexpr u32 find_keyword_seed()
+{
+    for (u32 seed = 0; ; seed++) {
+        bool used[KEYWORD_TABLE_SIZE] = {};
+        bool ok = true;
+        for (auto k : KEYWORDS) {
+            auto h = keyword_hash(k.text, seed);
+            ok = ok && !used[h];
+            used[h] = true;
         }
+        if (ok)
+            return seed;
     }
-    return Token::Type::Ident;
+}
+
+constexpr u32 KEYWORD_SEED = find_keyword_seed();
+
+constexpr std::array<Keyword, KEYWORD_TABLE_SIZE> keyword_table()
+{
+    std::array<Keyword, KEYWORD_TABLE_SIZE> table;
+    for (auto k : KEYWORDS)
+        table[keyword_hash(k.text, KEYWORD_SEED)] = k;
+    return table;
+}
+
+constexpr auto KEYWORD_TABLE = keyword_table();
+
+} // namespace
+
+Token::Type keyword_type(std::string_view word)
+{
+    if (word.size() < MIN_KEYWORD_SIZE || word.size() > MAX_KEYWORD_SIZE)
+        return Token::Type::Ident;
+    const auto &k = KEYWORD_TABLE[keyword_hash(word, KEYWORD_SEED)];
+    return k.text.size() == word.size() && std::memcmp(k.text.data(), word.data(), word.size()) == 0
+        ? k.type
+        : Token::Type::Ident;
+}
+
+Token::Type Lexer::get_ident_type()
+{
+    return keyword_type(text.substr(start, cur - start));
 }
 
 bool Lexer::is_cardinality_value(char c)
@@ -159,7 +197,7 @@ Token Lexer::cardinality(char start)
     if (start != 'n' && start != 'N')
         while (is_digit(peek()))
             advance();
-    return make(Token::Type::Card);
+    return make(Token::Type::Number);
 }
 
 Token Lexer::lex_one()
@@ -173,6 +211,7 @@ Token Lexer::lex_one()
     switch (c) {
     case '(': return make(Token::Type::LeftParen);
     case ')': return make(Token::Type::RightParen);
+    case '"': return string();
     }
     if (is_cardinality_value(c))
         return cardinality(c);
@@ -182,13 +221,35 @@ Token Lexer::lex_one()
     return error("unexpected character");
 }
 
-std::vector<Token> Lexer::lex()
+void TokenStream::push(Token t)
+{
+    bool error = t.type == Token::Type::Error;
+    if (error)
+        errors.emplace_back(size(), t.text);
+    types.push_back(u8(t.type));
+    starts.push_back(t.pos);
+    lengths.push_back(error ? 1 : t.text.size());
+}
+
+Token TokenStream::operator[](size_t i) const
+{
+    if (type(i) == Token::Type::Error) {
+        auto it = std::lower_bound(errors.begin(), errors.end(), i, [](const auto &e, size_t i) { return e.first < i; });
+        return Token { .type = Token::Type::Error, .text = it->second, .pos = starts[i] };
+    }
+    return Token { .type = type(i), .text = text.substr(starts[i], lengths[i]), .pos = starts[i] };
+}
+
+TokenStream Lexer::lex()
 {
-    std::vector<Token> v;
+    // diagrams average a token every 3 to 4 bytes.
+    TokenStream tokens;
+    tokens.text = text;
+    tokens.reserve(text.size() / 3 + 16);
     Token t;
     do {
         t = lex_one();
-        v.push_back(t);
+        tokens.push(t);
     } while (t.type != Token::Type::End);
-    return v;
+    return tokens;
 }
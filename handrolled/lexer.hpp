@@ -4,16 +4,34 @@
 #include <string_view>
 #include <vector>
 #include <utility>
+#include "util.hpp"
+
+// Keyword token types, followed by their spelling and aliases.
+#define KEYWORD_TYPES(O)                                        \
+    O(Entity,       "entity")                                   \
+    O(Attr,         "attr",         "attribute")                \
+    O(PK,           "pk",           "primary-key")              \
+    O(FK,           "fk",           "foreign-key")              \
+    O(Assoc,        "assoc",        "association")              \
+    O(Between,      "between")                                  \
+    O(Card,         "card",         "cardinality")              \
+    O(Gerarchy,     "gerarchy")                                 \
+    O(Type,         "type")                                     \
+    O(Subset,       "subset")                                   \
+    O(Partial,      "partial")                                  \
+    O(Total,        "total")                                    \
+    O(Exclusive,    "exclusive")                                \
+    O(Overlapped,   "overlapped")                               \
+    O(Parent,       "parent")                                   \
+    O(Child,        "child")                                    \
+    O(Include,      "include")
 
 #define TOKEN_TYPES(O) \
     O(LeftParen)        O(RightParen)       O(Ident)            O(Number)           \
-    O(End)              O(Error)            O(Entity)           O(Attr)             \
-    O(PK)               O(FK)               O(Assoc)            O(Between)          \
-    O(Card)             O(Gerarchy)         O(Type)             O(Subset)           \
-    O(Partial)          O(Total)            O(Exclusive)        O(Overlapped)       \
-    O(Parent)           O(Child)
+    O(String)           O(End)              O(Error)                                \
+    KEYWORD_TYPES(O)
 
-#define O(name) name,
+#define O(name, ...) name,
 struct Token {
     enum class Type {
         TOKEN_TYPES(O)
@@ -24,23 +42,56 @@ struct Token {
 #undef O
 
 std::string_view token_type_to_string(Token::Type t);
-std::pair<size_t, size_t> token_position(Token t, std::string_view text);
+
+// The keyword type of word, or Ident if it isn't one.
+Token::Type keyword_type(std::string_view word);
+
+// Offsets at which each line of a text starts, so that an offset can be turned
+// into a (line, column) pair with a binary search. The table is built the
+// first time a position is asked for.
+class LineIndex {
+    std::vector<u32> starts;
+
+public:
+    std::pair<size_t, size_t> position(std::string_view text, size_t pos);
+};
+
+// All the tokens of a text, stored as parallel arrays: one byte for the type,
+// plus the offset and length of its text. Error tokens point to the offending
+// character in the text; their messages are kept aside.
+struct TokenStream {
+    std::string_view text;
+    std::vector<u8>  types;
+    std::vector<u32> starts;
+    std::vector<u32> lengths;
+    std::vector<std::pair<u32, std::string_view>> errors;
+
+    size_t size() const                 { return types.size(); }
+    Token::Type type(size_t i) const    { return Token::Type(types[i]); }
+    void reserve(size_t n)              { types.reserve(n); starts.reserve(n); lengths.reserve(n); }
+    void push(Token t);
+    Token operator[](size_t i) const;
+};
 
 struct Lexer {
     std::string_view text;
     size_t start = 0;
     size_t cur = 0;
+    LineIndex lines;
 
     Lexer(std::string_view s) : text(s) { }
+    // Lexes s starting from an offset, so that token positions stay relative
+    // to the start of s. The text must not end in the middle of a token.
+    Lexer(std::string_view s, size_t from) : text(s), start(from), cur(from) { }
 
-    std::vector<Token> lex();
+    TokenStream lex();
     Token lex_one();
 
     char peek() const               { return text[cur]; }
     char peek_next() const          { return text[cur+1]; }
     char advance()                  { return text[cur++]; }
     bool at_end() const             { return text.size() == cur; }
-    auto position_of(Token t) const { return token_position(t, text); }
+    auto position_of(Token t)       { return lines.position(text, t.pos); }
 
     Token make(Token::Type type);
     Token error(std::string_view msg);
@@ -49,8 +100,7 @@ struct Lexer {
     bool is_cardinality_value(char c);
 
     Token ident();
+    Token string();
     Token cardinality(char start);
     Token::Type get_ident_type();
-    Token::Type check_keyword(size_t start, std::string_view rest, Token::Type type);
-    Token::Type check_two_keywords(size_t start, std::string_view first, std::string_view second, Token::Type type);
 };
@@ -1,21 +1,108 @@
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#include <thread>
 #include <fmt/core.h>
+#include "batch.hpp"
+#include "input.hpp"
 #include "lexer.hpp"
+#include "parallel.hpp"
 #include "parser.hpp"
 #include "util.hpp"
+#include "watch.hpp"
+
+static bool write_compiled(const Graph &graph, const char *path)
+{
+    std::FILE *out = std::string_view(path) == "-" ? stdout : std::fopen(path, "wb");
+    if (!out) {
+        fmt::print(stderr, "error: couldn't write {}: {}\n", path, std::strerror(errno));
+        return false;
+    }
+    bool ok = write_compiled_graph(graph, out);
+    ok &= out == stdout ? std::fflush(out) == 0 : std::fclose(out) == 0;
+    if (!ok)
+        fmt::print(stderr, "error: couldn't write {}\n", path);
+    return ok;
+}
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2) {
-        fmt::print("usage: {} [file]\n", *argv);
+    // -j N parses top-level objects on N threads; -j 0 uses one per core.
+    // --watch keeps running, printing the graph again whenever the file changes.
+    // --check only reports errors, and exits with 1 if there are any.
+    // --compile FILE writes the compiled graph to FILE instead of printing it.
+    // A compiled graph given as input is printed without parsing anything.
+    // With several files, directories or patterns, every file is parsed on its
+    // own and its graph written next to it; jobs then defaults to one per core.
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned jobs = 0;
+    bool watching = false;
+    bool checking = false;
+    const char *compile_to = nullptr;
+    int arg = 1;
+    for (; arg < argc - 1; arg++) {
+        std::string_view opt = argv[arg];
+        if (opt == "-j") {
+            auto n = string_convert<unsigned>(argv[arg+1]);
+            if (!n) {
+                fmt::print(stderr, "error: invalid number of jobs: {}\n", argv[arg+1]);
+                return 1;
+            }
+            jobs = n.value() != 0 ? n.value() : cores;
+            arg++;
+        } else if (opt == "--watch")
+            watching = true;
+        else if (opt == "--check")
+            checking = true;
+        else if (opt == "--compile" && arg + 2 < argc)
+            compile_to = argv[++arg];
+        else
+            break;
+    }
+    if (arg >= argc) {
+        fmt::print("usage: {} [-j jobs] [--watch | --check | --compile out] [file...]\n", *argv);
         return 1;
     }
+    if (argc - arg > 1 || names_many_files(argv[arg])) {
+        if (watching || compile_to) {
+            fmt::print(stderr, "error: can only {} one file\n", watching ? "watch" : "compile");
+            return 1;
+        }
+        auto files = expand_inputs(std::span(argv + arg, argv + argc));
+        return run_batch(files, jobs != 0 ? jobs : cores, checking);
+    }
+    if (jobs == 0)
+        jobs = 1;
+    if (watching) {
+        if (std::string_view(argv[arg]) == "-") {
+            fmt::print(stderr, "error: can't watch stdin\n");
+            return 1;
+        }
+        return watch(argv[arg], jobs);
+    }
 
-    auto text = file_to_string(argv[1]);
-    Lexer lexer{text.value()};
-    Parser parser{&lexer};
-    auto graph = parser.parse();
-    if (graph)
+    auto input = Input::open(argv[arg]);
+    if (!input)
+        return 1;
+    if (CompiledGraph::is_compiled(input->text())) {
+        auto graph = CompiledGraph::load(std::move(input.value()), argv[arg]);
+        if (!graph)
+            return 1;
         print_graph(graph.value());
-
+        return 0;
+    }
+    if (checking)
+        return check_diagram(input->text(), argv[arg]) ? 0 : 1;
+    std::optional<Graph> graph;
+    if (jobs > 1)
+        graph = parse_parallel(input->text(), jobs);
+    // Something's wrong: go through the serial parser to report it.
+    if (!graph)
+        graph = parse_diagram(input->text(), argv[arg]);
+    if (!graph)
+        return 0;
+    if (compile_to)
+        return write_compiled(graph.value(), compile_to) ? 0 : 1;
+    print_graph(graph.value());
     return 0;
 }
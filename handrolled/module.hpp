@@ -0,0 +1,46 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "parser.hpp"
+#include "util.hpp"
+
+// A file brought into diagrams with (include "path"). It's parsed on its own,
+// like a run: names it doesn't define are resolved each time it's spliced
+// into a diagram, against what the diagram defined before including it.
+struct Module {
+    std::string path;
+    ParsedRun run;
+};
+
+// Every module the process has parsed, by canonical path and the hash of its
+// contents, so that a file shared by many diagrams is only parsed once, and
+// parsed again if it changes. The path is part of the key because a module's
+// own includes are relative to it: the same text in two directories can
+// stand for different diagrams. A hash hit only counts if the text is the
+// same too. Threads parsing different diagrams can share it: the table is
+// only locked to look modules up and store them, not while parsing. Two
+// threads asking for the same new module at once both parse it and the first
+// one to finish wins, so nobody waits on a file that may include their own.
+class ModuleCache {
+    struct Entry {
+        std::string text;
+        std::unique_ptr<Module> module;     // Null if the file had errors,
+        std::string diagnostics;            // which are kept for later includes
+    };
+
+    std::mutex lock;
+    std::map<std::pair<std::string, u64>, std::vector<Entry>> modules;
+
+    const Module *found(const Entry &entry, std::string &diagnostics);
+
+public:
+    // Errors are added to diagnostics, and the caller gets null.
+    const Module *load(const std::string &path, std::string &diagnostics);
+};
+
+ModuleCache &module_cache();
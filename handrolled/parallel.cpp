@@ -0,0 +1,167 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include "lexer.hpp"
+#include "parser.hpp"
+
+std::vector<size_t> split_runs(std::string_view text, size_t parts)
+{
+    // An empty text asks for no parts at all, and still gets one run.
+    parts = std::max<size_t>(parts, 1);
+    std::vector<size_t> starts = { 0 };
+    size_t next = text.size() / parts;
+    int depth = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        switch (text[i]) {
+        case ';':
+            if (auto *nl = (const char *) std::memchr(text.data() + i, '\n', text.size() - i))
+                i = nl - text.data();
+            else
+                i = text.size();
+            break;
+        case '(':
+            if (depth++ == 0 && i >= next && i > starts.back()) {
+                starts.push_back(i);
+                next = i + text.size() / parts;
+            }
+            break;
+        case ')':
+            depth -= depth > 0;
+            break;
+        }
+    }
+    return starts;
+}
+
+static std::optional<ParsedRun> parse_one_run(std::string_view text, size_t start)
+{
+    Lexer lexer{text, start};
+    std::pmr::monotonic_buffer_resource arena;
+    Parser parser{&lexer, &arena};
+    return parser.parse_run();
+}
+
+namespace {
+
+// Where a run goes in the final graph.
+struct Placement {
+    int base;                       // Id of its first node
+    u32 first_link;                 // Offset of its first link
+    std::vector<int> resolved;      // Ids for its unresolved references
+};
+
+// The start node goes first, with the top-level objects as its links, then
+// each run in order.
+struct Layout {
+    std::vector<Placement> runs;
+    std::vector<int> top_level;
+    int num_nodes;
+    u32 num_links;
+};
+
+}
+
+// Runs are linked in order, keeping the top-level names defined so far, which
+// is what the outermost scope holds at that point in a serial parse. Only
+// references a run couldn't resolve by itself are looked up here: anything
+// that resolves to a later run is a forward reference, an error.
+// This part only looks at top-level objects and unresolved names; copying the
+// nodes into place is done afterwards, in parallel.
+static std::optional<Layout> place_runs(const std::vector<const ParsedRun *> &runs)
+{
+    auto key = [](Node::Type type, Symbol name) { return u64(name) << 8 | u64(type); };
+    std::unordered_map<u64, std::pair<size_t, int>> names; // To the run and the id in the run
+    std::vector<Placement> places;
+    std::vector<int> top_level;
+    int base = 1;
+    u32 first_link = 0;
+
+    for (size_t r = 0; r < runs.size(); r++) {
+        const ParsedRun *run = runs[r];
+        Placement place = { base, first_link, {} };
+        for (const auto &ref : run->unresolved) {
+            auto it = names.find(key(ref.type, ref.name));
+            if (it == names.end())
+                return std::nullopt;
+            auto [def_run, id] = it->second;
+            if (ref.attr) {
+                // The entity was parsed by an earlier run, which indexed its attributes.
+                id = runs[def_run]->attrs.find(runs[def_run]->graph, id, *ref.attr);
+                if (id == -1)
+                    return std::nullopt;
+            }
+            place.resolved.push_back(id + places[def_run].base);
+        }
+        for (int id : run->top_level) {
+            const Node &node = run->graph[id];
+            if (!names.emplace(key(node.type, node.name), std::make_pair(r, id)).second)
+                return std::nullopt;
+            top_level.push_back(id + base);
+        }
+        first_link += run->graph.num_links();
+        base += run->size;
+        places.push_back(std::move(place));
+    }
+    // Links of runs go after the ones of the start node.
+    u32 num_links = first_link + top_level.size();
+    for (auto &place : places)
+        place.first_link += top_level.size();
+    return Layout{ std::move(places), std::move(top_level), base, num_links };
+}
+
+std::optional<Graph> parse_parallel(std::string_view text, unsigned jobs)
+{
+    // A few runs per thread, so that a run full of big objects doesn't hold
+    // up everything else.
+    auto starts = split_runs(text, size_t(jobs) * 4);
+    std::vector<std::optional<ParsedRun>> runs(starts.size());
+    parallel_for(runs.size(), jobs, [&](size_t i) {
+        size_t end = i + 1 < starts.size() ? starts[i+1] : text.size();
+        runs[i] = parse_one_run(text.substr(0, end), starts[i]);
+    });
+
+    std::vector<const ParsedRun *> parsed;
+    for (const auto &run : runs) {
+        if (!run)
+            return std::nullopt;
+        parsed.push_back(&run.value());
+    }
+    return link_runs(parsed, jobs);
+}
+
+std::optional<Graph> link_runs(const std::vector<const ParsedRun *> &runs, unsigned jobs)
+{
+    auto layout = place_runs(runs);
+    if (!layout)
+        return std::nullopt;
+    std::vector<Node> nodes(layout->num_nodes);
+    std::vector<u32> offsets(layout->num_nodes + 1);
+    std::vector<int> links(layout->num_links);
+    nodes[0] = Node{Node::Type::Start, 0, intern_symbol("start")};
+    std::copy(layout->top_level.begin(), layout->top_level.end(), links.begin());
+    offsets[1] = layout->top_level.size();
+    offsets[layout->num_nodes] = layout->num_links;
+
+    parallel_for(runs.size(), jobs, [&](size_t r) {
+        const ParsedRun &run = *runs[r];
+        const auto &place = layout->runs[r];
+        auto relocate = [&](int link) {
+            return link >= 0           ? link + place.base
+                 : is_unresolved(link) ? place.resolved[unresolved_index(link)]
+                 :                       link;
+        };
+        u32 offset = place.first_link;
+        for (int i = 0; i < run.size; i++) {
+            Node &node = nodes[place.base + i] = run.graph[i];
+            node.id = place.base + i;
+            offsets[node.id] = offset;
+            for (int link : run.graph.links(i))
+                links[offset++] = relocate(link);
+        }
+    });
+    return Graph{std::move(nodes), std::move(offsets), std::move(links)};
+}
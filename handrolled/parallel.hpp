@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "graph.hpp"
+#include "parser.hpp"
+
+// Calls fn(i) for every i in [0, count), on jobs threads (the calling one
+// included). Work is handed out one index at a time.
+void parallel_for(size_t count, unsigned jobs, auto &&fn)
+{
+    std::atomic<size_t> next = 0;
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < count; )
+            fn(i);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::min<size_t>(jobs, count); i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &t : threads)
+        t.join();
+}
+
+// Same, for tasks whose sizes vary a lot, like whole files. Each thread starts
+// with its own contiguous share of the indices and works through it from the
+// back; once it runs out, it steals from the front of the other shares, so the
+// threads only contend on a share when one of them is out of work.
+void stealing_for(size_t count, unsigned jobs, auto &&fn)
+{
+    struct Share {
+        std::mutex lock;
+        size_t begin, end;
+    };
+    jobs = std::max<size_t>(1, std::min<size_t>(jobs, count));
+    std::vector<Share> shares(jobs);
+    for (unsigned i = 0; i < jobs; i++) {
+        shares[i].begin = count * i / jobs;
+        shares[i].end   = count * (i + 1) / jobs;
+    }
+    auto take = [&](unsigned self, size_t &task) {
+        {
+            std::lock_guard<std::mutex> guard{shares[self].lock};
+            if (shares[self].begin < shares[self].end) {
+                task = --shares[self].end;
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < jobs; i++) {
+            Share &victim = shares[(self + i) % jobs];
+            std::lock_guard<std::mutex> guard{victim.lock};
+            if (victim.begin < victim.end) {
+                task = victim.begin++;
+                return true;
+            }
+        }
+        return false;
+    };
+    auto worker = [&](unsigned self) {
+        for (size_t task; take(self, task); )
+            fn(task);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; i++)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for (auto &t : threads)
+        t.join();
+}
+
+// Parses a diagram on jobs threads. The text is split at top-level parens into
+// runs of objects, each run is parsed on its own, and then the runs are linked
+// together in order: names are resolved and ids are laid out exactly as the
+// serial parser would. Returns nullopt if any part of the diagram has errors,
+// without reporting them; the serial parser gives the proper diagnostics.
+std::optional<Graph> parse_parallel(std::string_view text, unsigned jobs);
+
+// Returns where each run starts, aiming for the given number of runs. Runs
+// only start on a left paren at the top level, so that no object is split
+// between runs; the first run starts at 0, so there's always at least one.
+std::vector<size_t> split_runs(std::string_view text, size_t parts);
+
+// Links runs parsed on their own into a diagram, in the given order. Returns
+// nullopt on errors, like parse_parallel().
+std::optional<Graph> link_runs(const std::vector<const ParsedRun *> &runs, unsigned jobs);
@@ -1,30 +1,127 @@
 #include "parser.hpp"
 
+#include <algorithm>
+#include <filesystem>
 #include <fmt/core.h>
+#include "module.hpp"
 
 using enum Token::Type;
 
 std::optional<Graph> Parser::parse()
 {
-    nodes.push(Node{Node::Type::Start, id++, "start", {}});
-    scopes.push_back({});
+    nodes.push_back({ Node{Node::Type::Start, id++, intern_symbol("start")}, link_stack.size() });
+    scopes.open();
     advance();
-    while (!lexer->at_end())
+    while (!check(End))
         top_level();
     if (had_error)
         return std::nullopt;
     pop_node();
+    return graph.freeze();
+}
+
+// Errors go to diagnostics if there is one, else straight to stderr.
+static void report(std::string_view errors, std::string *diagnostics)
+{
+    if (diagnostics)
+        diagnostics->append(errors);
+    else if (!errors.empty())
+        fmt::print(stderr, "{}", errors);
+}
+
+std::optional<Graph> parse_diagram(std::string_view text, std::string_view path, std::string *diagnostics)
+{
+    Lexer lexer{text};
+    auto tokens = lexer.lex();
+    // Scratch memory for the parser, released all at once.
+    std::pmr::monotonic_buffer_resource arena;
+    Parser parser{&lexer, &tokens, &arena, path};
+    auto graph = parser.parse();
+    report(parser.diagnostics, diagnostics);
     return graph;
 }
 
+// Pulls tokens one at a time instead of lexing them all first, as nothing is
+// kept once they're parsed.
+bool check_diagram(std::string_view text, std::string_view path, std::string *diagnostics)
+{
+    Lexer lexer{text};
+    std::pmr::monotonic_buffer_resource arena;
+    Parser parser{&lexer, &arena, path};
+    bool ok = parser.validate();
+    report(parser.diagnostics, diagnostics);
+    return ok;
+}
+
+// Like parse(), except that nodes are dropped as soon as they're done.
+// Attributes are indexed from the scope of their entity instead of its links.
+bool Parser::validate()
+{
+    validating = true;
+    nodes.push_back({ Node{Node::Type::Start, id++, intern_symbol("start")}, link_stack.size() });
+    scopes.open();
+    advance();
+    while (!check(End))
+        top_level();
+    return !had_error;
+}
+
+// Errors make the run fail without being reported: the caller is expected to
+// parse the whole diagram again serially to report them.
+std::optional<ParsedRun> Parser::parse_run()
+{
+    partial = true;
+    return parse_deferred();
+}
+
+// Included files are parsed like runs, except that errors are reported.
+std::optional<ParsedRun> Parser::parse_module()
+{
+    module = true;
+    return parse_deferred();
+}
+
+std::optional<ParsedRun> Parser::parse_deferred()
+{
+    defer_names = true;
+    // The root stands in for the start node, which isn't part of any run.
+    nodes.push_back({ Node{Node::Type::Start, -1, intern_symbol("start")}, link_stack.size() });
+    scopes.open();
+    advance();
+    while (!check(End))
+        top_level();
+    if (had_error)
+        return std::nullopt;
+    ParsedRun run;
+    run.graph       = std::move(graph);
+    run.size        = id;
+    run.top_level   = std::move(link_stack);
+    run.unresolved  = std::move(unresolved);
+    run.attrs       = std::move(attrs);
+    run.includes    = std::move(includes);
+    return run;
+}
+
+Token Parser::next()
+{
+    if (!tokens)
+        return lexer->lex_one();
+    // the last token of a stream is always End.
+    return (*tokens)[std::min(next_token++, tokens->size() - 1)];
+}
+
 void Parser::advance()
 {
+    if (panicking)
+        return;
     prev = cur;
     Token t;
-    while (t = lexer->lex_one(), t.type == Error) {
-        auto [line, col] = lexer->position_of(t);
-        fmt::print(stderr, "{}:{}: parse error: {}\n", line, col, t.text);
+    while (t = next(), t.type == Error) {
         had_error = true;
+        if (partial)
+            continue;
+        auto [line, col] = lexer->position_of(t);
+        fmt::format_to(std::back_inserter(diagnostics), "{}{}:{}: parse error: {}\n", error_prefix(), line, col, t.text);
     }
     cur = t;
     switch (prev.type) {
@@ -51,17 +148,31 @@ bool Parser::match(Token::Type type)
     return true;
 }
 
+// Only the first error of each top-level object is reported, the others
+// usually follow from it.
 void Parser::error_at(Token token, std::string_view msg)
 {
     had_error = true;
+    if (panicking)
+        return;
+    panicking = true;
+    resume = cur;
+    cur = Token{End, "", cur.pos};
+    if (partial)
+        return;
     auto [line, col] = lexer->position_of(token);
-    auto err_msg = fmt::format("{}:{}: parse error{}: {}",
-        line, col,
+    fmt::format_to(std::back_inserter(diagnostics), "{}{}:{}: parse error{}: {}\n",
+        error_prefix(), line, col,
           token.type == End   ? " on end of file"
         : token.type == Error ? ""
         : fmt::format(" at '{}'", token.text),
         msg);
-    throw ParseError(err_msg);
+}
+
+// Errors in the main file have no path, to keep them short.
+std::string Parser::error_prefix()
+{
+    return module ? fmt::format("{}:", path) : "";
 }
 
 void Parser::sync()
@@ -73,55 +184,74 @@ void Parser::sync()
     }
 }
 
-void Parser::push_node(Node::Type type, std::string_view name)
+void Parser::push_node(Node::Type type, Symbol name)
 {
-    auto r = curr_scope().emplace(Identifier{type, name}, id);
-    if (!r.second)
-        error(fmt::format("duplicate definition of {} of type {}", name, node_type_to_string(type)));
+    if (!scopes.declare(name, type, id))
+        error(fmt::format("duplicate definition of {} of type {}", symbol_to_string(name), node_type_to_string(type)));
     add_link(id);
-    nodes.push(Node{type, id++, name, {}});
-    scopes.push_back({});
+    nodes.push_back({ Node{type, id++, name}, link_stack.size() });
+    scopes.open();
 }
 
+// Nodes with errors in them are never added, so that later references to
+// them fail the same way whether or not they were finished.
 void Parser::pop_node()
 {
-    scopes.pop_back();
-    graph[nodes.top().id] = std::move(nodes.top());
-    nodes.pop();
+    if (panicking)
+        ;
+    else if (validating) {
+        if (curr().type == Node::Type::Entity)
+            scopes.for_each_in_current([&](Symbol name, Node::Type type, int id) {
+                if (type == Node::Type::Attr)
+                    attrs.add(curr().id, name, id);
+            });
+        link_stack.resize(nodes.back().first_link);
+    } else {
+        take_links(curr().id, nodes.back().first_link);
+        if (curr().type == Node::Type::Entity)
+            attrs.add_entity(graph, curr().id);
+        graph.add(curr());
+    }
+    scopes.close();
+    nodes.pop_back();
 }
 
-int Parser::find_name_in(const auto &scope, std::string_view name, Node::Type type)
+// Moves the links from first onwards out of the link stack and gives them to id.
+void Parser::take_links(int id, size_t first)
 {
-    auto i = scope.find(Identifier{type, name});
-    return i != scope.end() ? i->second : -1;
+    graph.add_links(id, std::span(link_stack).subspan(first));
+    link_stack.resize(first);
 }
 
-int Parser::find_name(std::string_view name, Node::Type type)
+int Parser::find_name(Symbol name, Node::Type type)
 {
-    for (auto scope = scopes.crbegin(); scope != scopes.crend(); ++scope)
-        if (int id = find_name_in(*scope, name, type); id != -1)
-            return id;
-    error(fmt::format("invalid reference for identifier {} of type {}", name, node_type_to_string(type)));
+    if (int id = scopes.find(name, type); id != -1)
+        return id;
+    if (defer_names) {
+        unresolved.push_back({ type, name, std::nullopt });
+        return unresolved_link(unresolved.size() - 1);
+    }
+    error(fmt::format("invalid reference for identifier {} of type {}", symbol_to_string(name), node_type_to_string(type)));
+    return -1;
 }
 
-int Parser::find_attr(int entity_id, std::string_view name)
+int Parser::find_attr(int entity_id, Symbol name)
 {
-    Node &entity = graph[entity_id];
-    for (auto id : entity.links) {
-        Node &attr = graph[id];
-        if (attr.type == Node::Type::Attr && attr.name == name)
-            return id;
-    }
-    error(fmt::format("identifier {} not found", name));
+    if (int id = attr_of(entity_id, name); id != -1)
+        return id;
+    error(fmt::format("identifier {} not found", symbol_to_string(name)));
+    return -1;
 }
 
-bool Parser::find_type_in(const auto &scope, Node::Type type)
+// When validating every attribute is in the index, as there are no links to scan.
+int Parser::attr_of(int entity_id, Symbol name)
 {
-    return std::find_if(scope.begin(), scope.end(), [&](const auto &obj) { return obj.first.type == type; }) != scope.end();
+    return validating ? attrs.find(entity_id, name) : attrs.find(graph, entity_id, name);
 }
 
 static const std::vector<Parser::Field> fields_tab[] = {
-    /* top level */ { { Entity, &Parser::entity }, { Assoc,  &Parser::association }, { Gerarchy, &Parser::gerarchy }, { FK, &Parser::foreign_key } },
+    /* top level */ { { Entity, &Parser::entity }, { Assoc,  &Parser::association }, { Gerarchy, &Parser::gerarchy }, { FK, &Parser::foreign_key },
+                      { Include, &Parser::include } },
     /* entity */    { { Attr, &Parser::attr },     { PK, &Parser::primary_key } },
     /* assoc */     { { Attr, &Parser::attr },     { Entity, &Parser::assoc_branch } },
     /* gerarchy */  { { Parent, &Parser::parent }, { Child, &Parser::child } },
@@ -143,8 +273,12 @@ void Parser::parse_field(const auto &fields)
 
 void Parser::parse_object(Node::Type type, std::string_view name, int fields_index, auto &&other_fields)
 {
-    consume(Ident, fmt::format("expected {} name", name));
-    push_node(type, prev.text);
+    // The message is only formatted on errors, as it would allocate for every object.
+    if (!match(Ident)) {
+        error_curr(fmt::format("expected {} name", name));
+        return;
+    }
+    push_node(type, intern_symbol(prev.text));
     other_fields();
     while (!check(RightParen) && !check(End))
         parse_field(fields_tab[fields_index]);
@@ -154,52 +288,176 @@ void Parser::parse_object(Node::Type type, std::string_view name, int fields_ind
 
 void Parser::top_level()
 {
-    try {
-        parse_field(fields_tab[0]);
-    } catch (const ParseError &error) {
-        fmt::print(stderr, "{}\n", error.what());
-        while (nodes.size() != 1)
-            nodes.pop();
-        sync();
-    }
+    size_t first = link_stack.size();
+    parse_field(fields_tab[0]);
+    if (!panicking)
+        return;
+    // Every open node has been popped by now.
+    link_stack.resize(first);
+    cur = resume;
+    panicking = false;
+    sync();
 }
 
 void Parser::entity()       { parse_object(Node::Type::Entity,   "entity",      1, [](){}); }
 void Parser::association()  { parse_object(Node::Type::Assoc,    "association", 2, [](){}); }
 void Parser::gerarchy()     { parse_object(Node::Type::Gerarchy, "gerarchy",    3, [&](){ curr().gerarchy_type = gerarchy_type(); }); }
 void Parser::foreign_key()  { parse_object(Node::Type::FK,       "foreign key", 4, [](){}); }
-void Parser::attr()         { parse_object(Node::Type::Attr,     "attribute",   5, [&](){ if (check(Card)) {
+void Parser::attr()         { parse_object(Node::Type::Attr,     "attribute",   5, [&](){ if (check(Number)) {
                                                                                               advance();
                                                                                               curr().cardinality = cardinality();
                                                                                           } }); }
 
-Node & Parser::add_node(Node::Type type, std::vector<int> &&links)
+// (include "path") brings in the top-level objects of another file. The file is
+// parsed once per process and spliced into every diagram that includes it.
+void Parser::include()
+{
+    if (!match(String)) {
+        error_curr("expected file name");
+        return;
+    }
+    Token file = prev;
+    if (partial) {
+        error_at(file, "includes are only done serially");
+        return;
+    }
+    auto file_path = include_path(file.text.substr(1, file.text.size() - 2));
+    const Module *mod = module_cache().load(file_path, diagnostics);
+    if (!mod) {
+        error_at(file, fmt::format("couldn't include {}", file_path));
+        return;
+    }
+    if (defer_names)
+        includes.push_back({ id, mod });
+    else
+        splice(*mod, file);
+    consume(RightParen, "expected right paren");
+}
+
+// Included paths are relative to the file including them.
+std::string Parser::include_path(std::string_view name)
 {
+    std::filesystem::path p{name};
+    if (p.is_relative() && !path.empty() && path != "-")
+        p = std::filesystem::path(path).parent_path() / p;
+    return p.lexically_normal().string();
+}
+
+// Looks up a name a module left unresolved in what's been defined so far, or
+// returns -1 after reporting it.
+int Parser::resolve(const Module &mod, const ParsedRun::Reference &ref, Token at)
+{
+    int id = scopes.find(ref.name, ref.type);
+    if (id == -1) {
+        error_at(at, fmt::format("invalid reference for identifier {} of type {} in {}",
+                                 symbol_to_string(ref.name), node_type_to_string(ref.type), mod.path));
+        return -1;
+    }
+    if (ref.attr && (id = attr_of(id, *ref.attr)) == -1)
+        error_at(at, fmt::format("identifier {} not found in {}", symbol_to_string(*ref.attr), mod.path));
+    return id;
+}
+
+// Copies the nodes of a module into the diagram, with the modules it includes
+// where their includes were, as if their text had been written there. The
+// module goes in one stretch of nodes at a time, from one include to the next,
+// and the names each stretch left unresolved are resolved against what's been
+// defined before it. A module is only spliced once per diagram, however many
+// times it's included. Returns false after an error.
+bool Parser::splice(const Module &mod, Token at)
+{
+    if (included.contains(&mod))
+        return true;
+    const ParsedRun &run = mod.run;
+    // Local id i becomes ids[i] in the diagram.
+    std::vector<int> ids(run.size);
+    size_t next_top = 0;
+    std::vector<int> links;
+    for (size_t k = 0, from = 0; k <= run.includes.size(); k++) {
+        size_t to = k < run.includes.size() ? run.includes[k].first : run.size;
+        for (size_t i = next_top; i < run.top_level.size() && size_t(run.top_level[i]) < to; i++) {
+            const Node &node = run.graph[run.top_level[i]];
+            if (scopes.find_in_current(node.name, node.type) != -1) {
+                error_at(at, fmt::format("duplicate definition of {} of type {} in {}",
+                                         symbol_to_string(node.name), node_type_to_string(node.type), mod.path));
+                return false;
+            }
+        }
+
+        for (size_t i = from; i < to; i++)
+            ids[i] = id + int(i - from);
+        for (size_t i = from; i < to && validating; i++) {
+            if (run.graph[i].type != Node::Type::Entity)
+                continue;
+            for (int link : run.graph.links(i))
+                if (link >= 0 && run.graph[link].type == Node::Type::Attr)
+                    attrs.add(ids[i], run.graph[link].name, ids[link]);
+        }
+        for (size_t i = from; i < to; i++) {
+            links.clear();
+            for (int link : run.graph.links(i)) {
+                if (!is_unresolved(link))
+                    links.push_back(link >= 0 ? ids[link] : link);
+                else if (int found = resolve(mod, run.unresolved[unresolved_index(link)], at); found != -1)
+                    links.push_back(found);
+                else
+                    return false;
+            }
+            if (validating)
+                continue;
+            Node node = run.graph[i];
+            node.id = ids[i];
+            graph.add(node);
+            graph.add_links(node.id, links);
+            if (node.type == Node::Type::Entity)
+                attrs.add_entity(graph, node.id);
+        }
+        id += int(to - from);
+        for (; next_top < run.top_level.size() && size_t(run.top_level[next_top]) < to; next_top++) {
+            int local = run.top_level[next_top];
+            scopes.declare(run.graph[local].name, run.graph[local].type, ids[local]);
+            add_link(ids[local]);
+        }
+        if (k < run.includes.size() && !splice(*run.includes[k].second, at))
+            return false;
+        from = to;
+    }
+    included.insert(&mod);
+    return true;
+}
+
+Node & Parser::add_node(Node::Type type, size_t first_link)
+{
+    if (validating)
+        link_stack.resize(first_link);
+    else
+        take_links(id, first_link);
     add_link(id);
-    auto it = graph.insert(std::make_pair(id, Node{type, id, "", std::move(links)}));
-    id++;
-    return it.first->second;
+    Node node{type, id++, intern_symbol("")};
+    return validating ? scratch = node : graph.add(node);
 }
 
 void Parser::primary_key()
 {
-    std::vector<int> links;
-    if (find_type_in(curr_scope(), Node::Type::PK))
+    size_t first = link_stack.size();
+    if (nodes.back().has_pk)
         error("can't have multiple primary-key fields in entity object");
+    nodes.back().has_pk = true;
     while (!check(RightParen) && !check(End)) {
         consume(Ident, "expected identifier");
-        links.push_back(find_name_in(curr_scope(), prev.text, Node::Type::Attr));
+        add_link(scopes.find_in_current(intern_symbol(prev.text), Node::Type::Attr));
     }
     consume(RightParen, "expected right paren");
-    add_node(Node::Type::PK, std::move(links));
+    add_node(Node::Type::PK, first);
 }
 
 void Parser::assoc_branch()
 {
+    size_t first = link_stack.size();
     consume(Ident, "expected identifier");
-    int id = find_name(prev.text, Node::Type::Entity);
-    consume(Card, "expected cardinality value");
-    auto &node = add_node(Node::Type::Card, std::vector<int>{id});
+    add_link(find_name(intern_symbol(prev.text), Node::Type::Entity));
+    consume(Number, "expected cardinality value");
+    auto &node = add_node(Node::Type::Card, first);
     node.cardinality = cardinality();
     consume(RightParen, "expected right paren");
 }
@@ -207,23 +465,44 @@ void Parser::assoc_branch()
 void Parser::reference_of(Node::Type type)
 {
     consume(Ident, "expected identifier");
-    add_link(find_name(prev.text, type));
+    add_link(find_name(intern_symbol(prev.text), type));
     consume(RightParen, "expected right paren");
 }
 
+// The parent of a gerarchy is always its first link, wherever it's written
+// among the children. Any other parent is left where it is.
+void Parser::parent()
+{
+    size_t before = link_stack.size();
+    reference_of(Node::Type::Entity);
+    auto &open = nodes.back();
+    if (link_stack.size() > before && !open.has_parent) {
+        std::rotate(link_stack.begin() + open.first_link, link_stack.end() - 1, link_stack.end());
+        open.has_parent = true;
+    }
+}
+
 void Parser::attr_ref()
 {
     consume(Ident, "expected identifier");
-    auto attr_name = prev.text;
+    auto attr_name = intern_symbol(prev.text);
     consume(Ident, "expected identifier");
-    add_link(find_attr(find_name(prev.text, Node::Type::Entity), attr_name));
+    int entity = find_name(intern_symbol(prev.text), Node::Type::Entity);
+    if (is_unresolved(entity)) {
+        unresolved[unresolved_index(entity)].attr = attr_name;
+        add_link(entity);
+    } else
+        add_link(find_attr(entity, attr_name));
     consume(RightParen, "expected right paren");
 }
 
 Cardinality Parser::cardinality()
 {
+    // The numbers may not be there after an error.
+    if (panicking)
+        return {};
     auto v1 = CardinalityValue::from_string(prev.text).value();
-    consume(Card, "expected cardinality value");
+    consume(Number, "expected cardinality value");
     auto v2 = CardinalityValue::from_string(prev.text).value();
     return std::make_pair(v1, v2);
 }
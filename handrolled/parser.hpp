@@ -1,66 +1,127 @@
 #pragma once
 
+#include <memory_resource>
+#include <optional>
 #include <span>
-#include <stack>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 #include "lexer.hpp"
 #include "graph.hpp"
+#include "scope.hpp"
 #include "util.hpp"
 
-class Parser {
-    struct Identifier {
+struct Module;
+
+// A run of top-level objects parsed on its own, as a piece of a bigger diagram.
+// Ids are local to the run and start from 0. Names the run doesn't define are
+// left for the caller to resolve: a link of unresolved_link(i) stands for the
+// node named by unresolved[i].
+struct ParsedRun {
+    struct Reference {
         Node::Type type;
-        std::string_view name;
-        bool operator==(const Identifier &other) const { return type == other.type && name == other.name; }
+        Symbol name;
+        std::optional<Symbol> attr; // For (attr x entity) references: x, with entity in name
     };
+    GraphBuilder graph;
+    int size = 0;
+    std::vector<int> top_level;
+    std::vector<Reference> unresolved;
+    AttrIndex attrs;
+    // Only for modules: what they include, by the id of the node right after each include
+    std::vector<std::pair<int, const Module *>> includes;
+};
 
-    struct IdentifierHash {
-        IdentifierHash() = default;
-        size_t operator()(const Identifier &key) const { return std::hash<std::string_view>()(key.name); }
-    };
+// -1 is taken by primary keys naming a missing attribute.
+constexpr int unresolved_link(size_t i)     { return -2 - int(i); }
+constexpr bool is_unresolved(int link)      { return link <= -2; }
+constexpr size_t unresolved_index(int link) { return -2 - link; }
 
-    struct ParseError : std::runtime_error {
-        using std::runtime_error::runtime_error;
-        using std::runtime_error::what;
+class Parser {
+    // A node that is still being parsed. Its links are all the links pushed
+    // on the link stack since first_link: links are only added to the
+    // innermost node, so they can share one stack.
+    struct OpenNode {
+        Node node;
+        size_t first_link;
+        bool has_pk = false;
+        bool has_parent = false;
     };
 
     Lexer *lexer;
+    const TokenStream *tokens = nullptr;
+    size_t next_token = 0;
     Token cur, prev;
+    // After an error the parser pretends the input has ended, so that every
+    // function returns on its own, until top_level puts back the real token
+    // in resume and skips to the next top-level object.
+    Token resume;
+    bool panicking = false;
     bool had_error = false;
+    bool validating = false;    // Only checking the diagram: no graph is built
+    bool partial = false;       // Parsing a run: errors aren't reported
+    bool module = false;        // Parsing an included file: errors are reported with its path
+    bool defer_names = false;   // Unknown names are left for the caller to resolve
+    std::string_view path;      // Of the file being parsed, to find the files it includes
     int parens = 0;
     int id = 0;
-    Graph graph;
-    std::stack<Node> nodes;
-    std::vector<std::unordered_map<Identifier, int, IdentifierHash>> scopes;
+    GraphBuilder graph;
+    std::vector<OpenNode> nodes;
+    std::vector<int> link_stack;
+    // All scopes share one name table, which lives in the arena given by the caller.
+    ScopeTable scopes;
+    AttrIndex attrs;
+    std::vector<ParsedRun::Reference> unresolved;
+    std::vector<std::pair<int, const Module *>> includes;
+    std::unordered_set<const Module *> included; // Already spliced into the diagram
+    Node scratch; // Stands in for nodes that aren't added when validating
 
 public:
+    // Errors are collected here rather than printed as they're found.
+    std::string diagnostics;
+
     struct Field {
         Token::Type type;
         void (Parser::*function)();
     };
 
-    Parser(Lexer *l) : lexer(l) { }
+    // the parser either pulls tokens from the lexer one at a time, or reads
+    // them from a stream the lexer produced beforehand.
+    Parser(Lexer *l, std::pmr::memory_resource *mem, std::string_view p = "")
+        : lexer(l), path(p), scopes(mem) { }
+    Parser(Lexer *l, const TokenStream *t, std::pmr::memory_resource *mem, std::string_view p = "")
+        : lexer(l), tokens(t), path(p), scopes(mem) { }
 
     std::optional<Graph> parse();
+    bool validate();
+    std::optional<ParsedRun> parse_run();
+    std::optional<ParsedRun> parse_module();
+    std::optional<ParsedRun> parse_deferred();
+    Token next();
     void advance();
     void consume(Token::Type type, std::string_view msg);
     bool match(Token::Type type);
     bool check(Token::Type type) { return cur.type == type; }
 
     void error_at(Token token, std::string_view msg);
+    std::string error_prefix();
     void sync();
     void error(std::string_view msg)      { error_at(prev, msg); }
     void error_curr(std::string_view msg) { error_at(cur,  msg); }
 
-    Node & add_node(Node::Type type, std::vector<int> &&links);
-    void push_node(Node::Type type, std::string_view name);
+    Node & add_node(Node::Type type, size_t first_link);
+    void push_node(Node::Type type, Symbol name);
     void pop_node();
-    int find_name_in(const auto &scope, std::string_view name, Node::Type type);
-    int find_name(std::string_view name, Node::Type type);
-    int find_attr(int entity_id, std::string_view name);
-    bool find_type_in(const auto &scope, Node::Type type);
-    Node & curr()                                   { return nodes.top(); }
-    auto & curr_scope()                             { return scopes.back(); }
-    void add_link(int id)                           { curr().links.push_back(id); }
+    int find_name(Symbol name, Node::Type type);
+    int find_attr(int entity_id, Symbol name);
+    int attr_of(int entity_id, Symbol name);
+    void take_links(int id, size_t first);
+    std::string include_path(std::string_view name);
+    bool splice(const Module &mod, Token at);
+    int resolve(const Module &mod, const ParsedRun::Reference &ref, Token at);
+    Node & curr()                                   { return nodes.back().node; }
+    void add_link(int id)                           { link_stack.push_back(id); }
 
     void parse_field(const auto &fields);
     void parse_object(Node::Type type, std::string_view name, int fields_index, auto &&other_fields);
@@ -69,6 +130,7 @@ public:
     void association();
     void gerarchy();
     void foreign_key();
+    void include();
     void attr();
     void primary_key();
     void assoc_branch();
@@ -76,8 +138,15 @@ public:
     void attr_ref();
     GerarchyType gerarchy_type();
     Cardinality cardinality();
-    void parent()     { reference_of(Node::Type::Entity); }
+    void parent();
     void child()      { reference_of(Node::Type::Entity); }
     void entity_ref() { reference_of(Node::Type::Entity); }
     void assoc_ref()  { reference_of(Node::Type::Assoc); }
 };
+
+// Parses a whole diagram on the calling thread. The path is the one of the file
+// the text comes from, to find the files it includes. Errors are added to
+// diagnostics, or printed to stderr if it's null.
+std::optional<Graph> parse_diagram(std::string_view text, std::string_view path, std::string *diagnostics = nullptr);
+// Same, but only tells whether the diagram is valid.
+bool check_diagram(std::string_view text, std::string_view path, std::string *diagnostics = nullptr);
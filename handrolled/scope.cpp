@@ -0,0 +1,89 @@
+#include "scope.hpp"
+
+void ScopeTable::close()
+{
+    for (size_t i = decls.size(); i > starts.back(); i--)
+        innermost[decls[i-1].key] = decls[i-1].shadowed;
+    decls.resize(starts.back());
+    starts.pop_back();
+}
+
+bool ScopeTable::declare(Symbol name, Node::Type type, int id)
+{
+    u32 scope = starts.size() - 1;
+    int &top = innermost.try_emplace(Key{type, name}, -1).first->second;
+    if (top != -1 && decls[top].scope == scope)
+        return false;
+    decls.push_back({ Key{type, name}, id, scope, top });
+    top = decls.size() - 1;
+    return true;
+}
+
+int ScopeTable::find(Symbol name, Node::Type type) const
+{
+    auto i = innermost.find(Key{type, name});
+    return i != innermost.end() && i->second != -1 ? decls[i->second].id : -1;
+}
+
+int ScopeTable::find_in_current(Symbol name, Node::Type type) const
+{
+    auto i = innermost.find(Key{type, name});
+    if (i == innermost.end() || i->second == -1)
+        return -1;
+    const Declaration &decl = decls[i->second];
+    return decl.scope == starts.size() - 1 ? decl.id : -1;
+}
+
+// Either the slot holding the key or the empty one where it would go.
+size_t AttrIndex::slot_of(int entity, Symbol name) const
+{
+    size_t mask = slots.size() - 1;
+    size_t i = ((u64(u32(entity)) << 32 | name) * 0x9E3779B97F4A7C15u) >> 32 & mask;
+    while (slots[i].entity != -1 && !(slots[i].entity == entity && slots[i].name == name))
+        i = (i + 1) & mask;
+    return i;
+}
+
+void AttrIndex::add(int entity, Symbol name, int id)
+{
+    // Kept at most two thirds full.
+    if ((count + 1) * 3 > slots.size() * 2) {
+        std::vector<Slot> old(slots.size() * 2);
+        std::swap(old, slots);
+        for (const Slot &slot : old)
+            if (slot.entity != -1)
+                slots[slot_of(slot.entity, slot.name)] = slot;
+    }
+    Slot &slot = slots[slot_of(entity, name)];
+    if (slot.entity != -1)
+        return;
+    slot = { entity, name, id };
+    count++;
+}
+
+void AttrIndex::add_entity(const GraphBuilder &graph, int entity)
+{
+    auto links = graph.links(entity);
+    if (links.size() < MIN_INDEXED_LINKS)
+        return;
+    for (int id : links)
+        if (graph[id].type == Node::Type::Attr)
+            add(entity, graph[id].name, id);
+}
+
+int AttrIndex::find(const GraphBuilder &graph, int entity, Symbol name) const
+{
+    auto links = graph.links(entity);
+    if (links.size() >= MIN_INDEXED_LINKS)
+        return find(entity, name);
+    for (int id : links)
+        if (graph[id].type == Node::Type::Attr && graph[id].name == name)
+            return id;
+    return -1;
+}
+
+int AttrIndex::find(int entity, Symbol name) const
+{
+    const Slot &slot = slots[slot_of(entity, name)];
+    return slot.entity != -1 ? slot.id : -1;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include "graph.hpp"
+#include "symbol.hpp"
+#include "util.hpp"
+
+/*
+ * Every name in every open scope, in one table keyed by name and type. The
+ * table points to the innermost declaration of each key, and each declaration
+ * points to the one it shadows. Declarations sit on a stack in the order they
+ * were made, so closing a scope pops the ones made inside it and puts back
+ * whatever they were hiding; opening a scope only records where the stack is.
+ */
+class ScopeTable {
+    struct Key {
+        Node::Type type;
+        Symbol name;
+        bool operator==(const Key &other) const { return type == other.type && name == other.name; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const { return std::hash<u64>()(u64(key.name) << 8 | u64(key.type)); }
+    };
+
+    struct Declaration {
+        Key key;
+        int id;
+        u32 scope;
+        int shadowed;
+    };
+
+    // Keys are never erased, they're set to -1 when nothing is declared.
+    std::pmr::unordered_map<Key, int, KeyHash> innermost;
+    std::pmr::vector<Declaration> decls;
+    std::pmr::vector<u32> starts;
+
+public:
+    explicit ScopeTable(std::pmr::memory_resource *mem)
+        : innermost(mem), decls(mem), starts(mem) { }
+
+    void open() { starts.push_back(decls.size()); }
+    void close();
+    size_t depth() const { return starts.size(); }
+
+    // Returns false if the current scope already has a declaration for name and type.
+    bool declare(Symbol name, Node::Type type, int id);
+    // Innermost declaration of name and type, or -1 if there is none.
+    int find(Symbol name, Node::Type type) const;
+    // Same, but only in the current scope.
+    int find_in_current(Symbol name, Node::Type type) const;
+    // Calls fn(name, type, id) for each declaration in the current scope.
+    void for_each_in_current(auto &&fn) const
+    {
+        for (size_t i = starts.back(); i < decls.size(); i++)
+            fn(decls[i].key.name, decls[i].key.type, decls[i].id);
+    }
+};
+
+// The attributes of wide entities, by entity id and attribute name, for
+// (attr x entity) references. Entities with only a few links are cheaper to
+// scan than to index, so they're left out. It's an open addressing table with
+// no allocation per entry. An entity with two attributes of the same name
+// keeps the first one, like a scan would.
+class AttrIndex {
+    static constexpr size_t MIN_INDEXED_LINKS = 32;
+
+    struct Slot {
+        int entity = -1;
+        Symbol name;
+        int id;
+    };
+
+    std::vector<Slot> slots = std::vector<Slot>(16);
+    size_t count = 0;
+
+    size_t slot_of(int entity, Symbol name) const;
+
+public:
+    // The entity's links must already be in the graph.
+    void add_entity(const GraphBuilder &graph, int entity);
+    // Indexes one attribute, however many links its entity has.
+    void add(int entity, Symbol name, int id);
+    // The attribute of entity with the given name, or -1.
+    int find(const GraphBuilder &graph, int entity, Symbol name) const;
+    // Same, for an index filled only through add().
+    int find(int entity, Symbol name) const;
+};
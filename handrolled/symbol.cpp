@@ -0,0 +1,56 @@
+#include "symbol.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+std::string_view SymbolTable::Shard::store(std::string_view name)
+{
+    // Names longer than a block get a block of their own.
+    if (name.size() > block_left) {
+        block_left = std::max(name.size(), BLOCK_SIZE);
+        blocks.push_back(std::make_unique<char[]>(block_left));
+        block_ptr = blocks.back().get();
+    }
+    char *p = block_ptr;
+    std::memcpy(p, name.data(), name.size());
+    block_ptr  += name.size();
+    block_left -= name.size();
+    return { p, name.size() };
+}
+
+std::string_view *SymbolTable::page_of(Symbol sym)
+{
+    auto &page = pages[sym >> PAGE_BITS];
+    if (auto *p = page.load(std::memory_order_acquire))
+        return p;
+    std::lock_guard<std::mutex> guard{pages_lock};
+    if (!page.load(std::memory_order_relaxed)) {
+        owned_pages.push_back(std::make_unique<std::string_view[]>(PAGE_SIZE));
+        page.store(owned_pages.back().get(), std::memory_order_release);
+    }
+    return page.load(std::memory_order_relaxed);
+}
+
+Symbol SymbolTable::intern(std::string_view name)
+{
+    size_t hash = std::hash<std::string_view>{}(name);
+    // The low bits pick the bucket inside the shard, so take high ones here.
+    auto &shard = shards[(hash >> 56) % NUM_SHARDS];
+    std::lock_guard<std::mutex> guard{shard.lock};
+    if (auto it = shard.index.find(name); it != shard.index.end())
+        return it->second;
+    auto stored = shard.store(name);
+    Symbol sym = count.fetch_add(1, std::memory_order_relaxed);
+    // Whoever gets this symbol back either holds the shard lock after us or
+    // was handed it by a thread that did.
+    page_of(sym)[sym & (PAGE_SIZE - 1)] = stored;
+    shard.index.emplace(stored, sym);
+    return sym;
+}
+
+SymbolTable &symbol_table()
+{
+    static SymbolTable table;
+    return table;
+}
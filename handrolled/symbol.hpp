@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "util.hpp"
+
+// A handle to an interned string. The same name always gets the same symbol,
+// so names can be compared and hashed as integers.
+using Symbol = u32;
+
+/*
+ * Strings are copied once, the first time they're seen, into large blocks that
+ * never move; interning a name that was already seen doesn't allocate.
+ * The table is split into shards by hash, each with its own lock, so that
+ * parsers running on different threads rarely wait on each other. Getting back
+ * the string of a symbol doesn't lock at all, since names live in pages that
+ * never move once allocated.
+ */
+class SymbolTable {
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr u32 PAGE_BITS = 16;
+    static constexpr size_t PAGE_SIZE = size_t(1) << PAGE_BITS;
+    static constexpr size_t NUM_PAGES = size_t(1) << (32 - PAGE_BITS);
+    static constexpr size_t NUM_SHARDS = 16;
+
+    struct Shard {
+        std::mutex lock;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char *block_ptr = nullptr;
+        size_t block_left = 0;
+        std::unordered_map<std::string_view, Symbol> index;
+
+        std::string_view store(std::string_view name);
+    };
+
+    Shard shards[NUM_SHARDS];
+    std::atomic<u32> count = 0;
+    std::mutex pages_lock;
+    std::vector<std::unique_ptr<std::string_view[]>> owned_pages;
+    std::atomic<std::string_view *> pages[NUM_PAGES] = {};
+
+    std::string_view *page_of(Symbol sym);
+
+public:
+    Symbol intern(std::string_view name);
+    std::string_view str(Symbol sym) const
+    {
+        return pages[sym >> PAGE_BITS].load(std::memory_order_acquire)[sym & (PAGE_SIZE - 1)];
+    }
+};
+
+// The symbol table shared by the parser, the graph and the printer.
+SymbolTable &symbol_table();
+
+inline Symbol intern_symbol(std::string_view name)      { return symbol_table().intern(name); }
+inline std::string_view symbol_to_string(Symbol sym)    { return symbol_table().str(sym); }
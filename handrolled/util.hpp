@@ -8,25 +8,21 @@
 #include <optional>
 #include <charconv>
 
+using u64 = uint64_t;
 using u32 = uint32_t;
+using u16 = uint16_t;
 using u8  = uint8_t;
 using i32 = int32_t;
 using i8  = int8_t;
 
-inline std::optional<std::string> file_to_string(std::string_view pathname)
+// Characters needed to print n in decimal.
+inline int count_digits(int n)
 {
-    FILE *f = fopen(pathname.data(), "r");
-    if (!f) {
-        perror("error:");
-        return std::nullopt;
-    }
-    fseek(f, 0, SEEK_END);
-    auto size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    std::string text(size, ' ');
-    fread(text.data(), sizeof(char), size, f);
-    fclose(f);
-    return text;
+    unsigned u = n < 0 ? 0u - unsigned(n) : unsigned(n);
+    int digits = n < 0 ? 2 : 1;
+    for (; u >= 10; u /= 10)
+        digits++;
+    return digits;
 }
 
 inline bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '-'; }
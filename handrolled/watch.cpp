@@ -0,0 +1,124 @@
+#include "watch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <fmt/core.h>
+#include "input.hpp"
+#include "lexer.hpp"
+#include "parallel.hpp"
+
+DiagramCache::Entry *DiagramCache::find(u64 key, std::string_view text)
+{
+    auto it = runs.find(key);
+    if (it == runs.end())
+        return nullptr;
+    auto e = std::find_if(it->second.begin(), it->second.end(), [&](const Entry &e) { return e.text == text; });
+    return e != it->second.end() ? &*e : nullptr;
+}
+
+std::optional<Graph> DiagramCache::parse(std::string_view text, unsigned jobs)
+{
+    version++;
+    // One run per top-level object. Slices end right before a top-level paren
+    // or at the end of the text, so they can be lexed on their own.
+    auto starts = split_runs(text, text.size());
+    std::vector<u64> keys(starts.size());
+    std::vector<std::string_view> slices(starts.size());
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < starts.size(); i++) {
+        size_t end = i + 1 < starts.size() ? starts[i+1] : text.size();
+        slices[i] = text.substr(starts[i], end - starts[i]);
+        keys[i] = std::hash<std::string_view>()(slices[i]);
+        if (Entry *e = find(keys[i], slices[i]))
+            e->version = version;
+        else
+            missing.push_back(i);
+    }
+
+    std::vector<std::optional<ParsedRun>> parsed(missing.size());
+    parallel_for(parsed.size(), jobs, [&](size_t i) {
+        Lexer lexer{slices[missing[i]]};
+        std::pmr::monotonic_buffer_resource arena;
+        Parser parser{&lexer, &arena};
+        parsed[i] = parser.parse_run();
+    });
+    num_parsed = parsed.size();
+    num_objects = starts.size();
+    for (size_t i = 0; i < parsed.size(); i++) {
+        if (!parsed[i])
+            return std::nullopt;
+        // The same object may be there twice.
+        size_t s = missing[i];
+        if (!find(keys[s], slices[s]))
+            runs[keys[s]].push_back(Entry{ std::string(slices[s]), std::move(parsed[i].value()), version });
+    }
+    for (auto it = runs.begin(); it != runs.end(); ) {
+        std::erase_if(it->second, [&](const Entry &e) { return e.version != version; });
+        it = it->second.empty() ? runs.erase(it) : std::next(it);
+    }
+
+    std::vector<const ParsedRun *> order(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        order[i] = &find(keys[i], slices[i])->run;
+    return link_runs(order, jobs);
+}
+
+namespace {
+
+struct FileStamp {
+    bool ok = false;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    timespec mtime;
+
+    static FileStamp of(const char *path)
+    {
+        struct stat st;
+        if (stat(path, &st) != 0)
+            return {};
+        return { true, st.st_dev, st.st_ino, st.st_size, st.st_mtim };
+    }
+
+    bool operator==(const FileStamp &o) const
+    {
+        return ok == o.ok && (!ok || (dev == o.dev && ino == o.ino && size == o.size
+                                      && mtime.tv_sec == o.mtime.tv_sec && mtime.tv_nsec == o.mtime.tv_nsec));
+    }
+};
+
+}
+
+int watch(const char *path, unsigned jobs)
+{
+    using namespace std::chrono;
+    DiagramCache cache;
+    for (bool first = true; ; first = false) {
+        // Editors often save by replacing the file, so after the first time
+        // it's fine for it to be missing for a bit. Others truncate it and
+        // write it again, which would fault a mapping: it's read instead.
+        auto stamp = FileStamp::of(path);
+        auto input = stamp.ok || first ? Input::read(path) : std::nullopt;
+        if (first && !input)
+            return 1;
+        if (input) {
+            auto start = steady_clock::now();
+            auto graph = cache.parse(input->text(), jobs);
+            if (!graph)
+                graph = parse_diagram(input->text(), path);
+            if (graph)
+                print_graph(graph.value());
+            std::fflush(stdout);
+            auto ms = duration<double, std::milli>(steady_clock::now() - start).count();
+            fmt::print(stderr, "{}: parsed {} of {} objects in {:.1f} ms\n", path, cache.num_parsed, cache.num_objects, ms);
+        }
+        while (FileStamp::of(path) == stamp)
+            std::this_thread::sleep_for(milliseconds(100));
+    }
+}
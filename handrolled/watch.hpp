@@ -0,0 +1,43 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "graph.hpp"
+#include "parser.hpp"
+#include "util.hpp"
+
+/*
+ * The top-level objects of the last version of a diagram, each parsed on its
+ * own as a run and kept by the hash of its text; a hash hit only counts if
+ * the text is the same too. A new version of the diagram
+ * is split into objects again, but only the ones whose text wasn't there
+ * before get parsed; then all runs are linked together, which resolves
+ * references and lays out ids as the serial parser would. Runs that the new
+ * version doesn't use anymore are dropped.
+ */
+class DiagramCache {
+    struct Entry {
+        std::string text;
+        ParsedRun run;
+        u64 version;
+    };
+
+    std::unordered_map<u64, std::vector<Entry>> runs;
+    u64 version = 0;
+
+    Entry *find(u64 key, std::string_view text);
+
+public:
+    size_t num_parsed = 0;  // Objects parsed by the last call
+    size_t num_objects = 0; // Objects in the last version
+
+    // Returns nullopt if the diagram has errors, without reporting them.
+    std::optional<Graph> parse(std::string_view text, unsigned jobs);
+};
+
+// Prints the graph of a file, then prints it again every time the file
+// changes. Only returns if the file can't be read the first time.
+int watch(const char *path, unsigned jobs);